@@ -0,0 +1,112 @@
+#include "AssetArchive.h"
+
+#include <cstring>
+
+#include "Log.h"
+
+MappedFile AssetArchive::archiveFile;
+std::string AssetArchive::baseDataPath = std::string();
+const ArchiveEntry* AssetArchive::entries = nullptr;
+uint32_t AssetArchive::numEntries = 0;
+
+bool AssetArchive::Initialize(const std::string baseDataPath)
+{
+	if (IsInitialized()) return false;
+
+	std::string archivePath = baseDataPath + ARCHIVE_FILE_NAME;
+
+	if (!archiveFile.Open(archivePath))
+	{
+		LOG_PRINT(LogTypes::Info, "%s has not been found, using loose files.", archivePath.c_str());
+		return false;
+	}
+
+	// Validate the header and the index, so lookups don't need to
+
+	const uint8_t* data = archiveFile.GetData();
+	size_t size = archiveFile.GetSize();
+
+	ArchiveHeader header;
+	bool isValid = size >= sizeof(ArchiveHeader);
+
+	if (isValid)
+	{
+		memcpy(&header, data, sizeof(ArchiveHeader));
+		isValid = header.magic == ARCHIVE_MAGIC && header.version == ARCHIVE_VERSION && header.numEntries <= (size - sizeof(ArchiveHeader)) / sizeof(ArchiveEntry);
+	}
+
+	const ArchiveEntry* archiveEntries = reinterpret_cast<const ArchiveEntry*>(data + sizeof(ArchiveHeader));
+
+	for (uint32_t e = 0; isValid && e < header.numEntries; e++)
+	{
+		const ArchiveEntry* entry = &archiveEntries[e];
+
+		isValid = memchr(entry->name, 0, ARCHIVE_NAME_SIZE) != nullptr &&
+			entry->offset <= size && entry->size <= size - entry->offset &&
+			(e == 0 || strcmp(archiveEntries[e - 1].name, entry->name) < 0);
+	}
+
+	if (!isValid)
+	{
+		LOG_PRINT(LogTypes::Error, "%s is not a valid archive, using loose files.", archivePath.c_str());
+		archiveFile.Close();
+		return false;
+	}
+
+	AssetArchive::baseDataPath = baseDataPath;
+	entries = archiveEntries;
+	numEntries = header.numEntries;
+
+	LOG_PRINT(LogTypes::Info, "Opened archive %s with %u files.", archivePath.c_str(), numEntries);
+
+	return true;
+}
+
+void AssetArchive::Dispose()
+{
+	archiveFile.Close();
+	baseDataPath.clear();
+	entries = nullptr;
+	numEntries = 0;
+}
+
+bool AssetArchive::Find(const std::string& filePath, const uint8_t** data, size_t* size)
+{
+	if (!IsInitialized()) return false;
+
+	// Files are stored relative to the data folder
+
+	if (filePath.compare(0, baseDataPath.size(), baseDataPath) != 0) return false;
+	const char* name = filePath.c_str() + baseDataPath.size();
+
+	uint32_t first = 0;
+	uint32_t last = numEntries;
+
+	while (first < last)
+	{
+		uint32_t middle = first + (last - first) / 2;
+		int32_t result = strcmp(entries[middle].name, name);
+
+		if (result == 0)
+		{
+			*data = archiveFile.GetData() + entries[middle].offset;
+			*size = static_cast<size_t>(entries[middle].size);
+			return true;
+		}
+
+		if (result < 0) first = middle + 1;
+		else last = middle;
+	}
+
+	return false;
+}
+
+bool AssetArchive::OpenFile(const std::string& filePath, MappedFile* file)
+{
+	const uint8_t* data;
+	size_t size;
+
+	if (Find(filePath, &data, &size)) return file->OpenView(data, size);
+
+	return file->Open(filePath);
+}
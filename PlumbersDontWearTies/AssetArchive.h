@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+
+// Archive with all the files used by the game, created with the packer tool.
+// The header is followed by the index, sorted by file name so it can be
+// searched in place, and then by the files, each one aligned to a page.
+
+constexpr const char* ARCHIVE_FILE_NAME = "GAME.PAK";
+constexpr uint32_t ARCHIVE_MAGIC = 0x4B415044; // "DPAK"
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr size_t ARCHIVE_NAME_SIZE = 32; // including the null terminator
+constexpr size_t ARCHIVE_ALIGNMENT = 4096; // bytes
+
+#pragma pack(push, 1)
+
+struct ArchiveHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numEntries;
+	uint32_t reserved;
+};
+
+struct ArchiveEntry
+{
+	char     name[ARCHIVE_NAME_SIZE]; // Relative to the data folder, upper case, with '/' separators
+	uint64_t offset;
+	uint64_t size;
+};
+
+#pragma pack(pop)
+
+class AssetArchive
+{
+private:
+	static MappedFile archiveFile;
+	static std::string baseDataPath;
+	static const ArchiveEntry* entries;
+	static uint32_t numEntries;
+
+public:
+	static bool Initialize(const std::string baseDataPath);
+	static void Dispose();
+
+	static bool Find(const std::string& filePath, const uint8_t** data, size_t* size);
+	static bool OpenFile(const std::string& filePath, MappedFile* file);
+
+	inline static std::string GetArchivePath() { return baseDataPath + ARCHIVE_FILE_NAME; }
+	inline static bool IsInitialized() { return archiveFile.IsOpen(); }
+};
@@ -1,15 +1,62 @@
 #include "Audio.h"
 
+#include <algorithm>
+#include <chrono>
+
+#include "AssetArchive.h"
 #include "Log.h"
+#include "Trace.h"
 
 SDL_AudioDeviceID Audio::audioDeviceId = 0;
-std::ifstream Audio::currentAudioStream = std::ifstream();
-int32_t Audio::currentAudioStreamLegth = 0;
+SDL_AudioSpec Audio::deviceSpec = {};
+
+std::thread Audio::feederThread = std::thread();
+std::atomic<bool> Audio::isFeederRunning(false);
+std::mutex Audio::commandMutex;
+std::condition_variable Audio::commandCondition;
+std::deque<AudioCommand> Audio::pendingCommands = std::deque<AudioCommand>();
+std::vector<std::string> Audio::pendingPreloadPaths = std::vector<std::string>();
+bool Audio::hasPendingPreload = false;
+
+std::map<std::string, std::shared_ptr<MappedFile>> Audio::preloadedFiles = std::map<std::string, std::shared_ptr<MappedFile>>();
+std::deque<std::string> Audio::preloadQueue = std::deque<std::string>();
+
+std::shared_ptr<MappedFile> Audio::currentFile = std::shared_ptr<MappedFile>();
+WavInfo Audio::currentWavInfo = {};
+AudioSource Audio::currentSource = {};
+SDL_AudioStream* Audio::conversionStream = nullptr;
+size_t Audio::conversionPosition = 0;
+
+RingBuffer Audio::ringBuffer(AUDIO_RING_BUFFER_SIZE);
+AudioSource Audio::publishedSource = {};
+std::atomic<uint32_t> Audio::requestedGeneration(0);
+std::atomic<uint32_t> Audio::publishedGeneration(0);
+std::atomic<uint32_t> Audio::acknowledgedGeneration(0);
+std::atomic<uint32_t> Audio::convertedGeneration(0);
+std::atomic<size_t> Audio::playbackPosition(0);
+
+std::atomic<uint32_t> Audio::clockSequence(0);
+std::atomic<uint32_t> Audio::clockGeneration(0);
+std::atomic<uint64_t> Audio::clockTimestamp(0);
+std::atomic<uint64_t> Audio::clockBytesBefore(0);
+std::atomic<uint64_t> Audio::clockBytesAfter(0);
+std::atomic<double> Audio::clockStartTime(0.0);
+std::atomic<bool> Audio::clockHasSource(false);
+std::atomic<bool> Audio::clockIsFinished(false);
+
+AudioSource Audio::callbackSource = {};
+uint32_t Audio::callbackGeneration = 0;
+uint64_t Audio::callbackBytesPlayed = 0;
+uint32_t Audio::callbackTraceReservation = 0;
 
 bool Audio::Initialize()
 {
 	if (IsInitialized()) return false;
 
+	// The callback can't allocate its trace buffer nor take the lock to register it
+
+	callbackTraceReservation = Trace::ReserveBuffer("Audio callback");
+
 	SDL_AudioSpec desiredAudioSpec, obtainedAudioSpec;
 	SDL_memset(&desiredAudioSpec, 0, sizeof(desiredAudioSpec));
 	desiredAudioSpec.freq = WAV_FREQUENCY;
@@ -21,14 +68,19 @@ bool Audio::Initialize()
 
 	if (audioDeviceId == 0)
 	{
-		Log::Print(LogTypes::Error, "Can't open audio device: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Error, "Can't open audio device: %s", SDL_GetError());
 		return false;
 	}
 	else
 	{
-		Log::Print(LogTypes::Info, "Audio Initialized: frequency %i, channels %u, samples %u, buffer size %u.", obtainedAudioSpec.freq, obtainedAudioSpec.channels, obtainedAudioSpec.samples, obtainedAudioSpec.size);
+		LOG_PRINT(LogTypes::Info, "Audio Initialized: frequency %i, channels %u, samples %u, buffer size %u.", obtainedAudioSpec.freq, obtainedAudioSpec.channels, obtainedAudioSpec.samples, obtainedAudioSpec.size);
 	}
 
+	deviceSpec = obtainedAudioSpec;
+
+	isFeederRunning = true;
+	feederThread = std::thread(FeederLoop);
+
 	SDL_PauseAudioDevice(audioDeviceId, 0);
 
 	return true;
@@ -38,82 +90,504 @@ void Audio::Dispose()
 {
 	StopAudio();
 
+	if (isFeederRunning)
+	{
+		{
+			std::lock_guard<std::mutex> lock(commandMutex);
+			isFeederRunning = false;
+		}
+
+		commandCondition.notify_one();
+		feederThread.join();
+	}
+
 	if (audioDeviceId > 0)
 	{
 		SDL_CloseAudioDevice(audioDeviceId);
 		audioDeviceId = 0;
 	}
+
+	CloseSource();
+	preloadedFiles.clear();
+	preloadQueue.clear();
 }
 
 bool Audio::LoadAudioFromWAV(const std::string baseDataPath, const std::string fileName)
 {
 	if (!IsInitialized()) return false;
 
-	StopAudio();
+	AudioCommand command;
+	command.type = AudioCommandTypes::Load;
+	command.filePath = baseDataPath + fileName;
+	command.time = 0.0;
+	PostCommand(command);
 
-	currentAudioStream = std::ifstream(baseDataPath + fileName, std::ios::binary);
+	LOG_PRINT(LogTypes::Info, "Playing audio %s...", fileName.c_str());
 
-	if (!currentAudioStream.is_open())
-	{
-		Log::Print(LogTypes::Error, "Can't load audio file: %s", SDL_GetError());
-		return false;
-	}
+	return true;
+}
+
+void Audio::PreloadAudioFromWAV(const std::string baseDataPath, const std::vector<std::string>& fileNames)
+{
+	if (!IsInitialized()) return;
 
-	currentAudioStream.seekg(0, std::ios_base::end);
-	currentAudioStreamLegth = static_cast<int32_t>(currentAudioStream.tellg());
+	// Not a command: what is playing right now is left untouched
 
-	currentAudioStream.seekg(WAV_DATA_START_POSITION, std::ios_base::beg);
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
 
-	Log::Print(LogTypes::Info, "Playing audio %s...", fileName.c_str());
+		pendingPreloadPaths.clear();
+		for (const std::string& fileName : fileNames)
+			pendingPreloadPaths.push_back(baseDataPath + fileName);
 
-	return true;
+		hasPendingPreload = true;
+	}
+
+	commandCondition.notify_one();
 }
 
 void Audio::StopAudio()
 {
-	if (!currentAudioStream.is_open()) return;
+	if (!IsInitialized()) return;
 
-	currentAudioStream.close();
-	currentAudioStream = std::ifstream();
-	currentAudioStreamLegth = 0;
+	AudioCommand command;
+	command.type = AudioCommandTypes::Stop;
+	command.time = 0.0;
+	PostCommand(command);
 }
 
 void Audio::SetAudioPlaybackTime(const double elapsedTime)
 {
 	if (!IsInitialized()) return;
-	if (!currentAudioStream.is_open()) return;
 
-	int32_t samplePosition = static_cast<int32_t>(elapsedTime * WAV_FREQUENCY * WAV_FORMAT_BYTES * WAV_CHANNELS);
+	AudioCommand command;
+	command.type = AudioCommandTypes::Seek;
+	command.time = elapsedTime;
+	PostCommand(command);
+}
+
+bool Audio::GetAudioPlaybackTime(double* elapsedTime)
+{
+	if (!IsInitialized()) return false;
+
+	uint32_t generation;
+	uint64_t timestamp, bytesBefore, bytesAfter;
+	double startTime;
+	bool hasSource, isFinished;
+	uint32_t sequence;
+
+	do
+	{
+		sequence = clockSequence.load(std::memory_order_acquire);
+		generation = clockGeneration.load(std::memory_order_relaxed);
+		timestamp = clockTimestamp.load(std::memory_order_relaxed);
+		bytesBefore = clockBytesBefore.load(std::memory_order_relaxed);
+		bytesAfter = clockBytesAfter.load(std::memory_order_relaxed);
+		startTime = clockStartTime.load(std::memory_order_relaxed);
+		hasSource = clockHasSource.load(std::memory_order_relaxed);
+		isFinished = clockIsFinished.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	while ((sequence & 1) != 0 || sequence != clockSequence.load(std::memory_order_relaxed));
+
+	// The clock belongs to an older command, or nothing is playing
+
+	if (generation != requestedGeneration.load(std::memory_order_acquire)) return false;
+	if (!hasSource) return false;
+
+	// When the callback runs, the buffer it filled previously starts being
+	// played, so interpolate inside that buffer with the time since then.
+
+	double bytesPerSecond = static_cast<double>(deviceSpec.freq) * deviceSpec.channels * (SDL_AUDIO_BITSIZE(deviceSpec.format) / 8);
+	double secondsSinceCallback = (SDL_GetPerformanceCounter() - timestamp) / static_cast<double>(SDL_GetPerformanceFrequency());
+
+	double previousBufferBytes = static_cast<double>(deviceSpec.size);
+	double playedBytes = bytesBefore - previousBufferBytes + SDL_min(secondsSinceCallback * bytesPerSecond, previousBufferBytes);
+	if (playedBytes < 0) playedBytes = 0;
+
+	if (isFinished && playedBytes >= bytesAfter) return false;
+	if (playedBytes > bytesAfter) playedBytes = static_cast<double>(bytesAfter);
 
-	// Make sure samplePosition is even, not odd, as audio is 16bit.
-	samplePosition &= ~1;
+	*elapsedTime = startTime + playedBytes / bytesPerSecond;
 
-	currentAudioStream.seekg(WAV_DATA_START_POSITION + samplePosition, std::ios_base::beg);
+	return true;
 }
 
-void Audio::AudioCallback(void* userdata, uint8_t* stream, int32_t len)
+void Audio::PostCommand(const AudioCommand& command)
+{
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		pendingCommands.push_back(command);
+
+		// From now on the callback plays silence instead of stale data
+		requestedGeneration++;
+	}
+
+	commandCondition.notify_one();
+}
+
+void Audio::FeederLoop()
 {
-	if (currentAudioStream.is_open())
+	Trace::SetThreadName("Audio feeder");
+
+	std::unique_lock<std::mutex> lock(commandMutex);
+
+	while (isFeederRunning)
 	{
-		currentAudioStream.read((char*)stream, len);
+		if (!pendingCommands.empty())
+		{
+			std::deque<AudioCommand> commands;
+			commands.swap(pendingCommands);
+			uint32_t generation = requestedGeneration;
+
+			lock.unlock();
+
+			// The callback may still be reading the current file
+			// until it picks up the new source, so keep it mapped.
+
+			std::shared_ptr<MappedFile> retiredFile = currentFile;
+
+			for (const AudioCommand& command : commands)
+				ApplyCommand(command);
+
+			publishedSource = currentSource;
+			publishedGeneration.store(generation, std::memory_order_release);
+
+			while (isFeederRunning && acknowledgedGeneration.load(std::memory_order_acquire) != generation)
+				SDL_Delay(1);
+
+			retiredFile.reset();
 
-		int32_t bytesRead = static_cast<int32_t>(currentAudioStream.gcount());
-		int32_t remainingBytes = len - bytesRead;
+			lock.lock();
+			continue;
+		}
+
+		if (hasPendingPreload)
+		{
+			std::vector<std::string> filePaths;
+			filePaths.swap(pendingPreloadPaths);
+			hasPendingPreload = false;
+
+			lock.unlock();
+			ApplyPreload(filePaths);
+			lock.lock();
+			continue;
+		}
+
+		lock.unlock();
+		bool hasFed = FeedSource();
+		if (!hasFed) hasFed = PreloadNextFile();
+		lock.lock();
+
+		if (!hasFed)
+		{
+			commandCondition.wait_for(lock, std::chrono::milliseconds(AUDIO_FEED_INTERVAL), [] { return !isFeederRunning || !pendingCommands.empty() || hasPendingPreload; });
+		}
+	}
+}
+
+void Audio::ApplyCommand(const AudioCommand& command)
+{
+	switch (command.type)
+	{
+		case AudioCommandTypes::Load:
+		{
+			CloseSource();
+			OpenSource(command.filePath);
 
-		if (remainingBytes > 0)
+			// Whatever else was preloaded wasn't chosen
+			preloadedFiles.clear();
+			preloadQueue.clear();
+			break;
+		}
+		case AudioCommandTypes::Seek:
 		{
-			SDL_memset(stream + bytesRead, 0, remainingBytes);
+			if (currentFile == nullptr) break;
+
+			// Seeking is just moving the read position inside the mapping
 
-			// We have finished reading the audio file,
-			// don't need to keep it open.
+			size_t position = static_cast<size_t>(command.time * currentWavInfo.sampleRate) * currentWavInfo.blockAlign;
+			if (position > currentWavInfo.dataSize) position = currentWavInfo.dataSize;
 
-			currentAudioStream.close();
-			currentAudioStream = std::ifstream();
-			currentAudioStreamLegth = 0;
+			currentSource.startTime = position / static_cast<double>(currentWavInfo.sampleRate * currentWavInfo.blockAlign);
+
+			if (currentSource.isConverted)
+			{
+				conversionPosition = position;
+				SDL_AudioStreamClear(conversionStream);
+			}
+			else
+			{
+				currentSource.position = position;
+			}
+
+			break;
 		}
+		case AudioCommandTypes::Stop:
+		{
+			CloseSource();
+			break;
+		}
+	}
+}
+
+void Audio::ApplyPreload(const std::vector<std::string>& filePaths)
+{
+	// Drop the files that are not wanted anymore
+
+	for (auto it = preloadedFiles.begin(); it != preloadedFiles.end();)
+	{
+		if (std::find(filePaths.begin(), filePaths.end(), it->first) != filePaths.end()) ++it;
+		else it = preloadedFiles.erase(it);
+	}
+
+	// Queue the new ones, in order of priority
+
+	preloadQueue.clear();
+
+	for (const std::string& filePath : filePaths)
+	{
+		if (preloadedFiles.find(filePath) != preloadedFiles.end()) continue;
+		if (std::find(preloadQueue.begin(), preloadQueue.end(), filePath) != preloadQueue.end()) continue;
+
+		preloadQueue.push_back(filePath);
+	}
+}
+
+bool Audio::PreloadNextFile()
+{
+	if (preloadQueue.empty()) return false;
+
+	TRACE_ZONE("Audio::PreloadNextFile");
+
+	std::string filePath = preloadQueue.front();
+	preloadQueue.pop_front();
+
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+
+	if (!AssetArchive::OpenFile(filePath, file.get()))
+	{
+		LOG_PRINT(LogTypes::Warning, "Can't preload audio file: %s", filePath.c_str());
+		return true;
+	}
+
+	file->Touch(0, AUDIO_PRELOAD_SIZE);
+	preloadedFiles[filePath] = file;
+
+	return true;
+}
+
+bool Audio::OpenSource(const std::string& filePath)
+{
+	TRACE_ZONE("Audio::OpenSource");
+
+	std::shared_ptr<MappedFile> file;
+
+	auto preloaded = preloadedFiles.find(filePath);
+	if (preloaded != preloadedFiles.end())
+	{
+		file = preloaded->second;
+		preloadedFiles.erase(preloaded);
+
+		LOG_PRINT(LogTypes::Info, "Using preloaded audio file %s.", filePath.c_str());
 	}
 	else
 	{
+		file = std::make_shared<MappedFile>();
+	}
+
+	if (!file->IsOpen() && !AssetArchive::OpenFile(filePath, file.get()))
+	{
+		LOG_PRINT(LogTypes::Error, "Can't load audio file: %s", filePath.c_str());
+		return false;
+	}
+
+	WavInfo wavInfo;
+	if (!WavParser::Parse(file->GetData(), file->GetSize(), &wavInfo))
+	{
+		LOG_PRINT(LogTypes::Error, "%s is not a supported WAV file.", filePath.c_str());
+		return false;
+	}
+
+	SDL_AudioFormat wavFormat = WavParser::GetAudioFormat(wavInfo);
+	bool isConverted = wavInfo.sampleRate != static_cast<uint32_t>(deviceSpec.freq) || wavInfo.channels != deviceSpec.channels || wavFormat != deviceSpec.format;
+
+	if (isConverted)
+	{
+		conversionStream = SDL_NewAudioStream(wavFormat, static_cast<uint8_t>(wavInfo.channels), static_cast<int32_t>(wavInfo.sampleRate), deviceSpec.format, deviceSpec.channels, deviceSpec.freq);
+
+		if (conversionStream == nullptr)
+		{
+			LOG_PRINT(LogTypes::Error, "Can't convert audio file %s: %s", filePath.c_str(), SDL_GetError());
+			return false;
+		}
+
+		LOG_PRINT(LogTypes::Info, "Converting audio from %u Hz, %u bits, %u channels.", wavInfo.sampleRate, wavInfo.bitsPerSample, wavInfo.channels);
+	}
+
+	currentFile = file;
+	currentWavInfo = wavInfo;
+	conversionPosition = 0;
+
+	currentSource.data = isConverted ? nullptr : file->GetData() + wavInfo.dataOffset;
+	currentSource.length = isConverted ? 0 : wavInfo.dataSize;
+	currentSource.position = 0;
+	currentSource.isConverted = isConverted;
+	currentSource.startTime = 0.0;
+
+	return true;
+}
+
+void Audio::CloseSource()
+{
+	if (conversionStream != nullptr)
+	{
+		SDL_FreeAudioStream(conversionStream);
+		conversionStream = nullptr;
+	}
+
+	currentFile.reset();
+	currentWavInfo = {};
+	currentSource = {};
+	conversionPosition = 0;
+}
+
+bool Audio::FeedSource()
+{
+	if (currentFile == nullptr) return false;
+
+	if (!currentSource.isConverted)
+	{
+		// The callback reads the mapping directly, just make sure
+		// the pages ahead of it are already in memory.
+
+		size_t position = playbackPosition.load(std::memory_order_relaxed);
+		currentFile->Touch(currentWavInfo.dataOffset + position, AUDIO_READAHEAD_SIZE);
+		return false;
+	}
+
+	size_t freeBytes = ringBuffer.GetFreeBytes();
+	if (freeBytes < AUDIO_FEED_CHUNK_SIZE) return false;
+
+	if (conversionPosition < currentWavInfo.dataSize && SDL_AudioStreamAvailable(conversionStream) < static_cast<int32_t>(AUDIO_FEED_CHUNK_SIZE))
+	{
+		size_t remainingBytes = currentWavInfo.dataSize - conversionPosition;
+		size_t inputBytes = remainingBytes < AUDIO_FEED_CHUNK_SIZE ? remainingBytes : AUDIO_FEED_CHUNK_SIZE;
+
+		SDL_AudioStreamPut(conversionStream, currentFile->GetData() + currentWavInfo.dataOffset + conversionPosition, static_cast<int32_t>(inputBytes));
+		conversionPosition += inputBytes;
+
+		if (conversionPosition >= currentWavInfo.dataSize) SDL_AudioStreamFlush(conversionStream);
+	}
+
+	uint8_t chunk[AUDIO_FEED_CHUNK_SIZE];
+	int32_t bytesConverted = SDL_AudioStreamGet(conversionStream, chunk, static_cast<int32_t>(AUDIO_FEED_CHUNK_SIZE));
+
+	if (bytesConverted <= 0)
+	{
+		// The callback finishes the source once it has drained the ring buffer
+
+		if (conversionPosition >= currentWavInfo.dataSize)
+			convertedGeneration.store(publishedGeneration.load(std::memory_order_relaxed), std::memory_order_release);
+
+		return false;
+	}
+
+	ringBuffer.Write(chunk, static_cast<size_t>(bytesConverted));
+
+	return true;
+}
+
+void Audio::FillBuffer(uint8_t* stream, const int32_t len)
+{
+	// Runs the audio callback on this thread, used to measure it. The device
+	// is locked so its own thread doesn't run the callback at the same time.
+
+	if (!IsInitialized()) return;
+
+	SDL_LockAudioDevice(audioDeviceId);
+	AudioCallback(nullptr, stream, len);
+	SDL_UnlockAudioDevice(audioDeviceId);
+}
+
+void Audio::AudioCallback(void* userdata, uint8_t* stream, int32_t len)
+{
+	// This runs on the real-time audio thread: no locks, no I/O.
+	// Its trace buffer has been reserved by Initialize.
+
+	Trace::ClaimBuffer(callbackTraceReservation);
+	TRACE_ZONE("Audio::AudioCallback");
+
+	uint32_t published = publishedGeneration.load(std::memory_order_acquire);
+	if (published != callbackGeneration)
+	{
+		callbackSource = publishedSource;
+		callbackGeneration = published;
+		ringBuffer.Discard();
+		callbackBytesPlayed = 0;
+		playbackPosition.store(callbackSource.position, std::memory_order_relaxed);
+		acknowledgedGeneration.store(published, std::memory_order_release);
+	}
+
+	if (requestedGeneration.load(std::memory_order_acquire) != callbackGeneration)
+	{
+		// A command hasn't been applied yet, the current source is stale
 		SDL_memset(stream, 0, len);
+		return;
+	}
+
+	uint64_t bytesBefore = callbackBytesPlayed;
+
+	size_t bytesRead = 0;
+
+	if (callbackSource.isConverted)
+	{
+		bytesRead = ringBuffer.Read(stream, static_cast<size_t>(len));
+	}
+	else if (callbackSource.data != nullptr)
+	{
+		size_t remainingBytes = callbackSource.length - callbackSource.position;
+		bytesRead = remainingBytes < static_cast<size_t>(len) ? remainingBytes : static_cast<size_t>(len);
+
+		SDL_memcpy(stream, callbackSource.data + callbackSource.position, bytesRead);
+		callbackSource.position += bytesRead;
+		playbackPosition.store(callbackSource.position, std::memory_order_relaxed);
+	}
+
+	int32_t remainingBytes = len - static_cast<int32_t>(bytesRead);
+
+	if (remainingBytes > 0)
+	{
+		SDL_memset(stream + bytesRead, 0, remainingBytes);
 	}
+
+	callbackBytesPlayed += bytesRead;
+
+	// A converted source may just be behind, it only ends when the feeder has
+	// converted all of it and nothing is left in the ring buffer
+
+	bool isFinished;
+
+	if (callbackSource.isConverted)
+		isFinished = convertedGeneration.load(std::memory_order_acquire) == callbackGeneration && ringBuffer.GetAvailableBytes() == 0;
+	else
+		isFinished = callbackSource.position >= callbackSource.length;
+
+	PublishClock(bytesBefore, callbackBytesPlayed, isFinished);
+}
+
+void Audio::PublishClock(const uint64_t bytesBefore, const uint64_t bytesAfter, const bool isFinished)
+{
+	clockSequence.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	clockGeneration.store(callbackGeneration, std::memory_order_relaxed);
+	clockTimestamp.store(SDL_GetPerformanceCounter(), std::memory_order_relaxed);
+	clockBytesBefore.store(bytesBefore, std::memory_order_relaxed);
+	clockBytesAfter.store(bytesAfter, std::memory_order_relaxed);
+	clockStartTime.store(callbackSource.startTime, std::memory_order_relaxed);
+	clockHasSource.store(callbackSource.isConverted || callbackSource.data != nullptr, std::memory_order_relaxed);
+	clockIsFinished.store(isFinished, std::memory_order_relaxed);
+
+	clockSequence.fetch_add(1, std::memory_order_release);
 }
@@ -1,10 +1,22 @@
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <SDL.h>
 
-// Format of game's WAV files
+#include "MappedFile.h"
+#include "RingBuffer.h"
+#include "WavParser.h"
+
+// Format of game's WAV files, used for the audio device
 
 constexpr int32_t WAV_FREQUENCY = 11025; // Hz
 constexpr SDL_AudioFormat WAV_FORMAT = AUDIO_S16; // 16 bits
@@ -12,27 +24,122 @@ constexpr int32_t WAV_FORMAT_BYTES = 2; // 16 bits
 constexpr int32_t WAV_CHANNELS = 2; // Stereo
 constexpr int32_t WAV_SAMPLES = 256;
 
-// TODO: Does audio data in a WAV always start in the same offset?
+// Streaming of audio data from the feeder thread to the audio callback
+
+constexpr size_t AUDIO_RING_BUFFER_SIZE = 64 * 1024; // bytes, must be a power of two
+constexpr size_t AUDIO_FEED_CHUNK_SIZE = 4096; // bytes
+constexpr size_t AUDIO_READAHEAD_SIZE = 64 * 1024; // bytes
+constexpr int32_t AUDIO_FEED_INTERVAL = 5; // milliseconds
+constexpr size_t AUDIO_PRELOAD_SIZE = 256 * 1024; // bytes touched of each preloaded file
+
+enum class AudioCommandTypes
+{
+	Load,
+	Seek,
+	Stop
+};
+
+struct AudioCommand
+{
+	AudioCommandTypes type;
+	std::string filePath;
+	double time;
+};
+
+// What the audio callback is playing. Files in the same format as the device
+// are played straight from the memory mapping, the rest are converted by the
+// feeder thread into the ring buffer.
 
-constexpr int32_t WAV_DATA_START_POSITION = 0x2c;
+struct AudioSource
+{
+	const uint8_t* data;
+	size_t length;
+	size_t position;
+	bool isConverted;
+	double startTime; // seconds
+};
 
 class Audio
 {
 private:
 	static SDL_AudioDeviceID audioDeviceId;
-	static std::ifstream currentAudioStream;
-	static int32_t currentAudioStreamLegth;
+	static SDL_AudioSpec deviceSpec;
+
+	// Feeder thread, the only one that opens files
+
+	static std::thread feederThread;
+	static std::atomic<bool> isFeederRunning;
+	static std::mutex commandMutex;
+	static std::condition_variable commandCondition;
+	static std::deque<AudioCommand> pendingCommands;
+	static std::vector<std::string> pendingPreloadPaths;
+	static bool hasPendingPreload;
+
+	// Files that may be played next, mapped ahead of time by the feeder thread
+
+	static std::map<std::string, std::shared_ptr<MappedFile>> preloadedFiles;
+	static std::deque<std::string> preloadQueue;
+
+	static std::shared_ptr<MappedFile> currentFile;
+	static WavInfo currentWavInfo;
+	static AudioSource currentSource;
+	static SDL_AudioStream* conversionStream;
+	static size_t conversionPosition;
+
+	// Shared between the feeder thread and the audio callback without locks.
+	// Every command increases the requested generation, and the callback plays
+	// silence until the feeder has published the source for that generation.
+
+	static RingBuffer ringBuffer;
+	static AudioSource publishedSource;
+	static std::atomic<uint32_t> requestedGeneration;
+	static std::atomic<uint32_t> publishedGeneration;
+	static std::atomic<uint32_t> acknowledgedGeneration;
+	static std::atomic<uint32_t> convertedGeneration; // Converted completely into the ring buffer
+	static std::atomic<size_t> playbackPosition;
+
+	// Playback clock, written by the audio callback and read by
+	// the game thread, protected by a sequence counter.
+
+	static std::atomic<uint32_t> clockSequence;
+	static std::atomic<uint32_t> clockGeneration;
+	static std::atomic<uint64_t> clockTimestamp;
+	static std::atomic<uint64_t> clockBytesBefore;
+	static std::atomic<uint64_t> clockBytesAfter;
+	static std::atomic<double> clockStartTime;
+	static std::atomic<bool> clockHasSource;
+	static std::atomic<bool> clockIsFinished;
+
+	// Only used by the audio callback
+
+	static AudioSource callbackSource;
+	static uint32_t callbackGeneration;
+	static uint64_t callbackBytesPlayed;
+	static uint32_t callbackTraceReservation; // Set before the device starts
 
 public:
 	static bool Initialize();
 	static void Dispose();
 
 	static bool LoadAudioFromWAV(const std::string baseDataPath, const std::string fileName);
+	static void PreloadAudioFromWAV(const std::string baseDataPath, const std::vector<std::string>& fileNames);
 	static void StopAudio();
 	static void SetAudioPlaybackTime(const double elapsedTime);
+	static bool GetAudioPlaybackTime(double* elapsedTime);
+
+	static void FillBuffer(uint8_t* stream, const int32_t len);
 
 	inline static bool IsInitialized() { return audioDeviceId > 0; }
 
 private:
+	static void PostCommand(const AudioCommand& command);
+	static void FeederLoop();
+	static void ApplyCommand(const AudioCommand& command);
+	static void ApplyPreload(const std::vector<std::string>& filePaths);
+	static bool PreloadNextFile();
+	static bool OpenSource(const std::string& filePath);
+	static void CloseSource();
+	static bool FeedSource();
+	static void PublishClock(const uint64_t bytesBefore, const uint64_t bytesAfter, const bool isFinished);
 	static void AudioCallback(void* userdata, uint8_t* stream, int32_t len);
-};
\ No newline at end of file
+};
@@ -0,0 +1,235 @@
+#include "BitmapDecoder.h"
+
+#include <fstream>
+#include <vector>
+
+#include "AssetArchive.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BITMAPDECODER_X86
+#include <immintrin.h>
+#endif
+
+#if defined(BITMAPDECODER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BITMAPDECODER_TARGET(x) __attribute__((target(x)))
+#else
+#define BITMAPDECODER_TARGET(x)
+#endif
+
+constexpr size_t BMP_FILE_HEADER_SIZE = 14;
+constexpr uint32_t BMP_INFO_HEADER_MIN_SIZE = 40;
+constexpr uint32_t BMP_COMPRESSION_RGB = 0;
+
+static inline uint16_t ReadUInt16(const uint8_t* data)
+{
+	return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t ReadUInt32(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24));
+}
+
+SDL_Surface* BitmapDecoder::Load(const std::string& filePath, const uint32_t pixelFormat)
+{
+	// Pictures in the archive are already in memory
+
+	const uint8_t* archivedData;
+	size_t archivedSize;
+
+	if (AssetArchive::Find(filePath, &archivedData, &archivedSize))
+		return Decode(archivedData, archivedSize, pixelFormat);
+
+	// Otherwise read the whole file at once
+
+	std::ifstream stream(filePath, std::ios::binary | std::ios::ate);
+
+	if (!stream.is_open())
+	{
+		SDL_SetError("Couldn't open %s", filePath.c_str());
+		return nullptr;
+	}
+
+	std::streamoff size = stream.tellg();
+	std::vector<uint8_t> data(static_cast<size_t>(size));
+
+	stream.seekg(0, std::ios_base::beg);
+	stream.read(reinterpret_cast<char*>(data.data()), size);
+
+	if (stream.gcount() != size)
+	{
+		SDL_SetError("Couldn't read %s", filePath.c_str());
+		return nullptr;
+	}
+
+	return Decode(data.data(), data.size(), pixelFormat);
+}
+
+SDL_Surface* BitmapDecoder::Decode(const uint8_t* data, const size_t size, const uint32_t pixelFormat)
+{
+	// Parse headers
+
+	bool isSupported = size >= BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_MIN_SIZE && data[0] == 'B' && data[1] == 'M';
+
+	uint32_t pixelsOffset = 0, infoHeaderSize = 0, compression = 0, numColors = 0;
+	int32_t width = 0, height = 0;
+	uint16_t bitCount = 0;
+
+	if (isSupported)
+	{
+		pixelsOffset = ReadUInt32(data + 10);
+		infoHeaderSize = ReadUInt32(data + 14);
+		width = static_cast<int32_t>(ReadUInt32(data + 18));
+		height = static_cast<int32_t>(ReadUInt32(data + 22));
+		bitCount = ReadUInt16(data + 28);
+		compression = ReadUInt32(data + 30);
+		numColors = ReadUInt32(data + 46);
+		if (numColors == 0) numColors = 256;
+
+		isSupported = infoHeaderSize >= BMP_INFO_HEADER_MIN_SIZE && bitCount == 8 && compression == BMP_COMPRESSION_RGB && width > 0 && height != 0 && numColors <= 256;
+	}
+
+	bool isBottomUp = height > 0;
+	if (height < 0) height = -height;
+
+	size_t stride = (static_cast<size_t>(width) + 3) & ~static_cast<size_t>(3);
+	size_t paletteOffset = BMP_FILE_HEADER_SIZE + infoHeaderSize;
+
+	if (isSupported)
+	{
+		isSupported = paletteOffset + numColors * 4 <= size && pixelsOffset + stride * height <= size;
+	}
+
+	if (!isSupported)
+	{
+		// Not an 8 bit uncompressed BMP, let SDL deal with it
+
+		SDL_RWops* rw = SDL_RWFromConstMem(data, static_cast<int32_t>(size));
+		if (rw == nullptr) return nullptr;
+
+		SDL_Surface* sdlSurface = SDL_LoadBMP_RW(rw, 1);
+		if (sdlSurface == nullptr) return nullptr;
+
+		SDL_Surface* convertedSurface = SDL_ConvertSurfaceFormat(sdlSurface, pixelFormat, 0);
+		SDL_FreeSurface(sdlSurface);
+		return convertedSurface;
+	}
+
+	// Build a palette with the colors already in the destination format.
+	// It always has 256 entries so any index can be looked up safely.
+
+	SDL_PixelFormat* format = SDL_AllocFormat(pixelFormat);
+	if (format == nullptr) return nullptr;
+
+	uint32_t palette[256];
+	for (uint32_t c = 0; c < 256; c++)
+	{
+		if (c < numColors)
+		{
+			const uint8_t* color = data + paletteOffset + c * 4; // BGRX
+			palette[c] = SDL_MapRGBA(format, color[2], color[1], color[0], 255);
+		}
+		else
+		{
+			palette[c] = SDL_MapRGBA(format, 0, 0, 0, 255);
+		}
+	}
+
+	SDL_FreeFormat(format);
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, pixelFormat);
+	if (surface == nullptr) return nullptr;
+
+	// Convert rows, flipping them if the BMP is stored bottom-up
+
+	const uint8_t* indices = data + pixelsOffset;
+
+	for (int32_t y = 0; y < height; y++)
+	{
+		int32_t sourceRow = isBottomUp ? height - 1 - y : y;
+		uint32_t* pixels = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch);
+
+		ConvertIndexedRow(indices + sourceRow * stride, pixels, width, palette);
+	}
+
+	return surface;
+}
+
+void BitmapDecoder::ConvertIndexedRow(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette)
+{
+	typedef void (*ConvertRowFunction)(const uint8_t*, uint32_t*, const int32_t, const uint32_t*);
+
+	static const ConvertRowFunction convertRow =
+		SDL_HasAVX2() ? &ConvertIndexedRowAVX2 :
+		SDL_HasSSE2() ? &ConvertIndexedRowSSE2 :
+		&ConvertIndexedRowScalar;
+
+	convertRow(indices, pixels, count, palette);
+}
+
+void BitmapDecoder::ConvertIndexedRowScalar(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette)
+{
+	int32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		pixels[i + 0] = palette[indices[i + 0]];
+		pixels[i + 1] = palette[indices[i + 1]];
+		pixels[i + 2] = palette[indices[i + 2]];
+		pixels[i + 3] = palette[indices[i + 3]];
+	}
+
+	for (; i < count; i++)
+		pixels[i] = palette[indices[i]];
+}
+
+BITMAPDECODER_TARGET("sse2")
+void BitmapDecoder::ConvertIndexedRowSSE2(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette)
+{
+#ifdef BITMAPDECODER_X86
+	// SSE2 has no gather, so the lookups are scalar, but the indices
+	// are read 16 at a time and the pixels are written 4 at a time.
+
+	int32_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i));
+		uint8_t lanes[16];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), block);
+
+		for (int32_t l = 0; l < 16; l += 4)
+		{
+			__m128i colors = _mm_setr_epi32(palette[lanes[l]], palette[lanes[l + 1]], palette[lanes[l + 2]], palette[lanes[l + 3]]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i + l), colors);
+		}
+	}
+
+	ConvertIndexedRowScalar(indices + i, pixels + i, count - i, palette);
+#else
+	ConvertIndexedRowScalar(indices, pixels, count, palette);
+#endif
+}
+
+BITMAPDECODER_TARGET("avx2")
+void BitmapDecoder::ConvertIndexedRowAVX2(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette)
+{
+#ifdef BITMAPDECODER_X86
+	// Widen 8 indices to 32 bits and gather their colors in one instruction
+
+	int32_t i = 0;
+	const int32_t* table = reinterpret_cast<const int32_t*>(palette);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i indices0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + i)));
+		__m256i indices1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + i + 8)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_i32gather_epi32(table, indices0, 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i + 8), _mm256_i32gather_epi32(table, indices1, 4));
+	}
+
+	ConvertIndexedRowScalar(indices + i, pixels + i, count - i, palette);
+#else
+	ConvertIndexedRowScalar(indices, pixels, count, palette);
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include <SDL.h>
+
+// Decoder for the 8 bit paletted, uncompressed BMP files used by the game.
+// The picture is converted to a 32 bit format in a single pass, flipping the
+// rows and skipping their padding. Any other kind of BMP is left to SDL.
+
+class BitmapDecoder
+{
+public:
+	static SDL_Surface* Load(const std::string& filePath, const uint32_t pixelFormat);
+	static SDL_Surface* Decode(const uint8_t* data, const size_t size, const uint32_t pixelFormat);
+
+	static void ConvertIndexedRow(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette);
+
+private:
+	static void ConvertIndexedRowScalar(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette);
+	static void ConvertIndexedRowSSE2(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette);
+	static void ConvertIndexedRowAVX2(const uint8_t* indices, uint32_t* pixels, const int32_t count, const uint32_t* palette);
+};
@@ -5,3 +5,5 @@
 #define PROJECT_VER_MAJOR "0"
 #define PROJECT_VER_MINOR "2"
 #define PTOJECT_VER_PATCH "0"
+
+#define LOG_MIN_LEVEL 0
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Everything needed to draw a frame of the game. The game thread publishes a
+// copy whenever one of them changes, and the main thread draws from its copy
+// without touching the game.
+
+struct FrameSnapshot
+{
+	bool isRunning = false;
+	std::string pictureFileName = std::string(); // Relative to the data path, empty before the first picture
+
+	bool isWaitingDecision = false;
+	bool hasSelection = false;
+	int32_t selectionX = 0;
+	int32_t selectionY = 0;
+	int32_t selectionW = 0;
+	int32_t selectionH = 0;
+
+	std::string scoreText = std::string();
+};
@@ -0,0 +1,232 @@
+#include "FrameStats.h"
+
+#include <cstdio>
+#include <memory>
+
+#include "Log.h"
+#include "Renderer.h"
+#include "Trace.h"
+
+LatencyHistogram FrameStats::histograms[static_cast<int32_t>(FramePhases::Count)];
+uint64_t FrameStats::slowFrames = 0;
+uint64_t FrameStats::hitchFrames = 0;
+
+Uint64 FrameStats::frameStartTime = 0;
+Uint64 FrameStats::phaseStartTime = 0;
+
+bool FrameStats::isOverlayVisible = false;
+Uint64 FrameStats::lastOverlayTime = 0;
+
+std::string FrameStats::statsFilePath = std::string();
+Uint64 FrameStats::lastSaveTime = 0;
+
+std::thread FrameStats::saverThread = std::thread();
+std::mutex FrameStats::saverMutex;
+std::condition_variable FrameStats::saverCondition;
+bool FrameStats::isSaverRunning = false;
+bool FrameStats::isSnapshotPending = false;
+FrameStats::Snapshot FrameStats::pendingSnapshot;
+
+void FrameStats::BeginFrame()
+{
+	frameStartTime = SDL_GetPerformanceCounter();
+	phaseStartTime = frameStartTime;
+}
+
+void FrameStats::EndPhase(const FramePhases phase)
+{
+	Uint64 currentTime = SDL_GetPerformanceCounter();
+
+	histograms[static_cast<int32_t>(phase)].Record(static_cast<uint64_t>(GetSeconds(phaseStartTime, currentTime) * 1000000.0));
+	phaseStartTime = currentTime;
+}
+
+void FrameStats::EndFrame()
+{
+	Uint64 currentTime = SDL_GetPerformanceCounter();
+	double frameSeconds = GetSeconds(frameStartTime, currentTime);
+
+	histograms[static_cast<int32_t>(FramePhases::Frame)].Record(static_cast<uint64_t>(frameSeconds * 1000000.0));
+
+	if (frameSeconds > FRAME_SLOW_THRESHOLD) slowFrames++;
+	if (frameSeconds > FRAME_HITCH_THRESHOLD) hitchFrames++;
+
+	// Regenerating the text every frame would show up in the stats it shows
+
+	if (isOverlayVisible && GetSeconds(lastOverlayTime, currentTime) >= FRAME_OVERLAY_INTERVAL)
+	{
+		Renderer::SetOverlayText(GetSummary());
+		lastOverlayTime = currentTime;
+	}
+
+	if (!statsFilePath.empty() && GetSeconds(lastSaveTime, currentTime) >= FRAME_STATS_SAVE_INTERVAL)
+	{
+		// Started with the first save, so it only runs once the main loop does
+
+		if (!isSaverRunning)
+		{
+			isSaverRunning = true;
+			saverThread = std::thread(SaverLoop);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(saverMutex);
+			TakeSnapshot(&pendingSnapshot);
+			isSnapshotPending = true;
+		}
+
+		saverCondition.notify_one();
+		lastSaveTime = currentTime;
+	}
+}
+
+void FrameStats::ToggleOverlay()
+{
+	isOverlayVisible = !isOverlayVisible;
+
+	if (isOverlayVisible)
+	{
+		Renderer::SetOverlayText(GetSummary());
+		lastOverlayTime = SDL_GetPerformanceCounter();
+	}
+	else
+	{
+		Renderer::SetOverlayText(std::string());
+	}
+}
+
+void FrameStats::SetStatsFile(const std::string& filePath)
+{
+	statsFilePath = filePath;
+	lastSaveTime = SDL_GetPerformanceCounter();
+}
+
+void FrameStats::Dispose()
+{
+	if (isSaverRunning)
+	{
+		{
+			std::lock_guard<std::mutex> lock(saverMutex);
+			isSaverRunning = false;
+		}
+
+		saverCondition.notify_one();
+		saverThread.join();
+	}
+
+	if (statsFilePath.empty()) return;
+
+	// The main loop has ended, so the last save can be done from here
+
+	std::unique_ptr<Snapshot> snapshot(new Snapshot());
+	TakeSnapshot(snapshot.get());
+	Save(*snapshot);
+}
+
+void FrameStats::SaverLoop()
+{
+	Trace::SetThreadName("Frame stats");
+
+	std::unique_ptr<Snapshot> snapshot(new Snapshot());
+	std::unique_lock<std::mutex> lock(saverMutex);
+
+	while (true)
+	{
+		saverCondition.wait(lock, [] { return !isSaverRunning || isSnapshotPending; });
+		if (!isSnapshotPending) break;
+
+		*snapshot = pendingSnapshot;
+		isSnapshotPending = false;
+
+		lock.unlock();
+		Save(*snapshot);
+		lock.lock();
+	}
+}
+
+void FrameStats::TakeSnapshot(Snapshot* snapshot)
+{
+	for (int32_t p = 0; p < static_cast<int32_t>(FramePhases::Count); p++)
+		snapshot->histograms[p] = histograms[p];
+
+	snapshot->slowFrames = slowFrames;
+	snapshot->hitchFrames = hitchFrames;
+}
+
+bool FrameStats::Save(const Snapshot& snapshot)
+{
+	FILE* file = fopen(statsFilePath.c_str(), "w");
+
+	if (file == nullptr)
+	{
+		LOG_PRINT(LogTypes::Error, "Can't write the frame stats to %s", statsFilePath.c_str());
+		return false;
+	}
+
+	const LatencyHistogram& frames = snapshot.histograms[static_cast<int32_t>(FramePhases::Frame)];
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"frames\": %llu,\n", static_cast<unsigned long long>(frames.GetCount()));
+	fprintf(file, "  \"slow_frames\": %llu,\n", static_cast<unsigned long long>(snapshot.slowFrames));
+	fprintf(file, "  \"slow_frame_threshold_ms\": %.1f,\n", FRAME_SLOW_THRESHOLD * 1000.0);
+	fprintf(file, "  \"hitch_frames\": %llu,\n", static_cast<unsigned long long>(snapshot.hitchFrames));
+	fprintf(file, "  \"hitch_frame_threshold_ms\": %.1f,\n", FRAME_HITCH_THRESHOLD * 1000.0);
+	fprintf(file, "  \"phases\": [\n");
+
+	for (int32_t p = 0; p < static_cast<int32_t>(FramePhases::Count); p++)
+	{
+		const LatencyHistogram& histogram = snapshot.histograms[p];
+
+		fprintf(file, "    { \"name\": \"%s\", \"count\": %llu, \"mean_us\": %.1f, \"p50_us\": %llu, \"p90_us\": %llu, \"p99_us\": %llu, \"p999_us\": %llu, \"max_us\": %llu }%s\n",
+			GetPhaseName(static_cast<FramePhases>(p)), static_cast<unsigned long long>(histogram.GetCount()), histogram.GetMean(),
+			static_cast<unsigned long long>(histogram.GetPercentile(50.0)), static_cast<unsigned long long>(histogram.GetPercentile(90.0)),
+			static_cast<unsigned long long>(histogram.GetPercentile(99.0)), static_cast<unsigned long long>(histogram.GetPercentile(99.9)),
+			static_cast<unsigned long long>(histogram.GetMax()), p == static_cast<int32_t>(FramePhases::Count) - 1 ? "" : ",");
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+
+	return true;
+}
+
+std::string FrameStats::GetSummary()
+{
+	char line[128];
+	std::string summary = "ms         mean     p50     p99     max";
+
+	for (int32_t p = 0; p < static_cast<int32_t>(FramePhases::Count); p++)
+	{
+		const LatencyHistogram& histogram = histograms[p];
+
+		snprintf(line, sizeof(line), "\n%-8s %7.2f %7.2f %7.2f %7.2f", GetPhaseName(static_cast<FramePhases>(p)), histogram.GetMean() / 1000.0,
+			histogram.GetPercentile(50.0) / 1000.0, histogram.GetPercentile(99.0) / 1000.0, histogram.GetMax() / 1000.0);
+		summary += line;
+	}
+
+	snprintf(line, sizeof(line), "\nSlow frames: %llu, hitches: %llu of %llu", static_cast<unsigned long long>(slowFrames),
+		static_cast<unsigned long long>(hitchFrames), static_cast<unsigned long long>(histograms[static_cast<int32_t>(FramePhases::Frame)].GetCount()));
+	summary += line;
+
+	return summary;
+}
+
+const char* FrameStats::GetPhaseName(const FramePhases phase)
+{
+	switch (phase)
+	{
+		case FramePhases::Events: return "Events";
+		case FramePhases::Upload: return "Upload";
+		case FramePhases::Render: return "Render";
+		case FramePhases::Present: return "Present";
+		case FramePhases::Frame: return "Frame";
+		default: return "Unknown";
+	}
+}
+
+double FrameStats::GetSeconds(const Uint64 startTime, const Uint64 endTime)
+{
+	return (endTime - startTime) / static_cast<double>(SDL_GetPerformanceFrequency());
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <SDL.h>
+
+#include "LatencyHistogram.h"
+
+// Frames slower than this miss at least one refresh at 60 Hz, and hitches are visible stutter
+
+constexpr double FRAME_SLOW_THRESHOLD = 1.0 / 30.0; // seconds
+constexpr double FRAME_HITCH_THRESHOLD = 0.1; // seconds
+
+constexpr double FRAME_OVERLAY_INTERVAL = 0.5; // seconds between overlay updates
+constexpr double FRAME_STATS_SAVE_INTERVAL = 10.0; // seconds between saves of the stats file
+
+enum class FramePhases
+{
+	Events,
+	Upload, // Loading what changed in the frame published by the game thread
+	Render,
+	Present,
+	Frame,
+	Count
+};
+
+// Time spent in each phase of the main loop. The phases are measured one
+// after the other from the beginning of the frame, so each one ends where
+// the next one starts. The stats file is written by a thread of its own
+// from a copy of the histograms, so saving doesn't show up as a slow frame.
+
+class FrameStats
+{
+private:
+	struct Snapshot
+	{
+		LatencyHistogram histograms[static_cast<int32_t>(FramePhases::Count)];
+		uint64_t slowFrames;
+		uint64_t hitchFrames;
+	};
+
+	static LatencyHistogram histograms[static_cast<int32_t>(FramePhases::Count)];
+	static uint64_t slowFrames;
+	static uint64_t hitchFrames;
+
+	static Uint64 frameStartTime;
+	static Uint64 phaseStartTime;
+
+	static bool isOverlayVisible;
+	static Uint64 lastOverlayTime;
+
+	static std::string statsFilePath;
+	static Uint64 lastSaveTime;
+
+	static std::thread saverThread;
+	static std::mutex saverMutex;
+	static std::condition_variable saverCondition;
+	static bool isSaverRunning;
+	static bool isSnapshotPending;
+	static Snapshot pendingSnapshot;
+
+public:
+	static void BeginFrame();
+	static void EndPhase(const FramePhases phase);
+	static void EndFrame();
+
+	static void ToggleOverlay();
+	static void SetStatsFile(const std::string& filePath);
+
+	// Stops the thread saving the stats and writes them one last time
+	static void Dispose();
+
+	inline static bool IsOverlayVisible() { return isOverlayVisible; }
+
+private:
+	static void SaverLoop();
+	static void TakeSnapshot(Snapshot* snapshot);
+	static bool Save(const Snapshot& snapshot);
+	static std::string GetSummary();
+	static const char* GetPhaseName(const FramePhases phase);
+	static double GetSeconds(const Uint64 startTime, const Uint64 endTime);
+};
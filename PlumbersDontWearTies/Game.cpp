@@ -1,10 +1,13 @@
 #include "Game.h"
 
-#include <fstream>
+#include <algorithm>
+#include <vector>
 
 #include "Audio.h"
 #include "Log.h"
+#include "PicturePrefetcher.h"
 #include "Renderer.h"
+#include "Trace.h"
 
 Game::Game(const std::string baseDataPath)
 {
@@ -12,27 +15,12 @@ Game::Game(const std::string baseDataPath)
 
 	// Load GAME.BIN
 
-	std::ifstream gameBinStream(baseDataPath + "GAME.BIN", std::ios::binary);
-
-	if (!gameBinStream.is_open())
-	{
-		Log::Print(LogTypes::Critical, "GAME.BIN has not been found.");
-		return;
-	}
-
-	gameData = new _gameBinFile;
-	gameBinStream.read((char*)gameData, sizeof(_gameBinFile));
-	gameBinStream.close();
-	gameData->SwapEndianness();
+	sceneGraph.Load(baseDataPath);
 }
 
 Game::~Game()
 {
-	if (gameData != nullptr)
-	{
-		delete gameData;
-		gameData = nullptr;
-	}
+	sceneGraph.Clear();
 }
 
 void Game::Start()
@@ -40,12 +28,17 @@ void Game::Start()
 	if (!IsInitialized()) return;
 
 	currentGameState = GameStates::BeginScene;
-	currentSceneIndex = 1; // Skip the PC CD-Rom info screens
+	currentSceneIndex = GAME_START_SCENE_INDEX;
 	lastDecisionSceneIndex = 0;
 	currentPictureIndex = 0;
 	currentDecisionIndex = -1;
 	currentScore = 0;
-	currentWaitTimer = 0.0;
+	currentSceneTime = 0.0;
+	currentWallSceneTime = 0.0;
+	currentPictureEndTime = 0.0;
+	currentPictureFileName.clear();
+	currentScoreText.clear();
+	isFrameChanged = true;
 }
 
 void Game::Stop()
@@ -53,13 +46,14 @@ void Game::Stop()
 	if (!IsInitialized()) return;
 
 	currentGameState = GameStates::Stopped;
+	isFrameChanged = true;
 }
 
 void Game::Update(const double deltaSeconds)
 {
 	if (!IsInitialized()) return;
 
-	_sceneDef* scene = &gameData->scenes[currentSceneIndex];
+	const SceneNode* scene = &sceneGraph.GetScene(currentSceneIndex);
 
 	switch (currentGameState)
 	{
@@ -69,35 +63,58 @@ void Game::Update(const double deltaSeconds)
 		}
 		case GameStates::BeginScene:
 		{
-			Log::Print(LogTypes::Info, "Entered scene %s.", scene->szSceneFolder);
+			TRACE_ZONE("Game::Update BeginScene");
 
-			std::string wavPath = scene->szSceneFolder + std::string("/") + scene->szDialogWav;
-			ToUpperCase(&wavPath);
-			Audio::LoadAudioFromWAV(baseDataPath, wavPath);
+			LOG_PRINT(LogTypes::Info, "Entered scene %s.", scene->name.c_str());
 
 			currentPictureIndex = 0;
+			currentSceneTime = 0.0;
+			currentWallSceneTime = 0.0;
+			PrefetchPictures(scene);
+
+			Audio::LoadAudioFromWAV(baseDataPath, scene->dialogWav.fileName);
+
 			currentGameState = GameStates::BeginPicture;
 			break;
 		}
 		case GameStates::BeginPicture:
 		{
-			_pictureDef* picture = &gameData->pictures[scene->pictureIndex + currentPictureIndex];
-			std::string bmpPath = scene->szSceneFolder + std::string("/") + picture->szBitmapFile;
-			ToUpperCase(&bmpPath);
-			Renderer::LoadPictureFromBMP(baseDataPath, bmpPath);
+			TRACE_ZONE("Game::Update BeginPicture");
 
-			currentWaitTimer = picture->duration / 10.0;
-			Log::Print(LogTypes::Info, "Waiting %.2f seconds...", currentWaitTimer);
+			PrefetchPictures(scene);
+
+			// The main thread uploads the picture once the frame is published,
+			// so have it decoded by then instead of decoding it there
+
+			const PictureNode* picture = &sceneGraph.GetPicture(*scene, currentPictureIndex);
+			PicturePrefetcher::Wait(picture->bitmap.filePath);
+
+			currentPictureFileName = picture->bitmap.fileName;
+			isFrameChanged = true;
+
+			currentPictureEndTime = picture->endTime;
+			LOG_PRINT(LogTypes::Info, "Waiting %.2f seconds...", currentPictureEndTime - currentSceneTime);
 
 			currentGameState = GameStates::WaitingPicture;
 			break;
 		}
 		case GameStates::WaitingPicture:
 		{
-			currentWaitTimer -= deltaSeconds;
-			if (currentWaitTimer <= 0)
+			currentSceneTime += deltaSeconds;
+			currentWallSceneTime += deltaSeconds;
+
+			// The audio clock is the master, frame times are only used
+			// when there is no audio or it hasn't started yet.
+
+			double audioTime;
+			bool isAudioClockUsed = Audio::GetAudioPlaybackTime(&audioTime);
+			if (isAudioClockUsed) currentSceneTime = audioTime;
+
+			if (currentSceneTime >= currentPictureEndTime)
 			{
-				currentWaitTimer = 0;
+				if (isAudioClockUsed)
+					LOG_PRINT(LogTypes::Info, "Picture ended at %.2f seconds, frame timer drift %.1f ms.", currentSceneTime, (currentWallSceneTime - currentSceneTime) * 1000.0);
+
 				currentPictureIndex++;
 				if (currentPictureIndex >= scene->numPics)
 					currentGameState = GameStates::BeginDecision;
@@ -109,63 +126,75 @@ void Game::Update(const double deltaSeconds)
 		}
 		case GameStates::BeginDecision:
 		{
+			TRACE_ZONE("Game::Update BeginDecision");
+
 			if (scene->numActions == 1)
 			{
 				SetNextScene(&scene->actions[0]);
 				break;
 			}
 
-			std::string bmpPath = scene->szSceneFolder + std::string("/") + scene->szDecisionBmp;
-			ToUpperCase(&bmpPath);
-			Renderer::LoadPictureFromBMP(baseDataPath, bmpPath);
+			PicturePrefetcher::Wait(scene->decisionBmp.filePath);
 
-			Renderer::GenerateScoreText("Your score is: " + std::to_string(currentScore));
+			currentPictureFileName = scene->decisionBmp.fileName;
+			currentScoreText = "Your score is: " + std::to_string(currentScore);
+			isFrameChanged = true;
 
-			Log::Print(LogTypes::Info, "%i decisions, waiting for input...", scene->numActions);
+			LOG_PRINT(LogTypes::Info, "%i decisions, waiting for input...", scene->numActions);
 
 			currentDecisionIndex = -1;
+			preloadedDecisionIndex = -2;
 			currentGameState = GameStates::WaitingDecision;
 
 			break;
 		}
 		case GameStates::WaitingDecision:
 		{
+			// Preload again whenever the highlighted decision changes,
+			// so its branch is loaded first.
+
+			if (preloadedDecisionIndex != currentDecisionIndex)
+			{
+				TRACE_ZONE("Game::Update PreloadDecisionBranches");
+
+				preloadedDecisionIndex = currentDecisionIndex;
+				PreloadDecisionBranches(scene);
+			}
+
 			break;
 		}
 		default:
 		{
-			Log::Print(LogTypes::Error, "State %i is not implemented.", currentGameState);
+			LOG_PRINT(LogTypes::Error, "State %i is not implemented.", currentGameState);
 			break;
 		}
 	}
 }
 
-void Game::Render()
+void Game::GetFrame(FrameSnapshot* frame)
 {
-	if (!IsInitialized()) return;
+	isFrameChanged = false;
 
-	Renderer::Clear(0, 0, 0);
-	Renderer::RenderPicture();
+	frame->isRunning = IsRunning();
+	frame->pictureFileName = currentPictureFileName;
+	frame->scoreText = currentScoreText;
+	frame->isWaitingDecision = currentGameState == GameStates::WaitingDecision;
+	frame->hasSelection = false;
 
-	if (currentGameState == GameStates::WaitingDecision)
-	{
-		_sceneDef* scene = &gameData->scenes[currentSceneIndex];
+	if (!frame->isWaitingDecision) return;
 
-		if (currentDecisionIndex >= 0 && currentDecisionIndex < scene->numActions)
-		{
-			_actionDef* action = &scene->actions[currentDecisionIndex];
-			int32_t x = action->cHotspotTopLeft.x;
-			int32_t y = action->cHotspotTopLeft.y;
-			int32_t w = action->cHotspotBottomRigh.x - action->cHotspotTopLeft.x;
-			int32_t h = action->cHotspotBottomRigh.y - action->cHotspotTopLeft.y;
+	const SceneNode* scene = &sceneGraph.GetScene(currentSceneIndex);
 
-			Renderer::RenderDecisionSelection(x, y, w, h);
-		}
+	if (currentDecisionIndex >= 0 && currentDecisionIndex < scene->numActions)
+	{
+		const ActionNode* action = &scene->actions[currentDecisionIndex];
 
-		Renderer::RenderScore();
+		frame->hasSelection = true;
+		frame->selectionX = action->hotspotX;
+		frame->selectionY = action->hotspotY;
+		frame->selectionW = action->hotspotWidth;
+		frame->selectionH = action->hotspotHeight;
 	}
-
-	Renderer::Present();
 }
 
 void Game::SelectDecision(const int8_t decision)
@@ -174,9 +203,10 @@ void Game::SelectDecision(const int8_t decision)
 	if (currentGameState != GameStates::WaitingDecision) return;
 
 	if (decision < 0) return;
-	if (decision >= gameData->scenes[currentSceneIndex].numActions) return;
+	if (decision >= sceneGraph.GetScene(currentSceneIndex).numActions) return;
 
 	currentDecisionIndex = decision;
+	isFrameChanged = true;
 }
 
 void Game::SelectNextDecision()
@@ -184,13 +214,15 @@ void Game::SelectNextDecision()
 	if (!IsInitialized()) return;
 	if (currentGameState != GameStates::WaitingDecision) return;
 
+	isFrameChanged = true;
+
 	if (currentDecisionIndex < 0)
 	{
 		currentDecisionIndex = 0;
 		return;
 	}
 
-	int16_t numActions = gameData->scenes[currentSceneIndex].numActions;
+	int16_t numActions = sceneGraph.GetScene(currentSceneIndex).numActions;
 	if (currentDecisionIndex < numActions - 1) currentDecisionIndex++;
 }
 
@@ -199,64 +231,80 @@ void Game::SelectPreviousDecision()
 	if (!IsInitialized()) return;
 	if (currentGameState != GameStates::WaitingDecision) return;
 
+	isFrameChanged = true;
+
 	if (currentDecisionIndex < 0)
 	{
-		currentDecisionIndex = gameData->scenes[currentSceneIndex].numActions - 1;
+		currentDecisionIndex = sceneGraph.GetScene(currentSceneIndex).numActions - 1;
 		return;
 	}
 
 	if (currentDecisionIndex > 0) currentDecisionIndex--;
 }
 
+double Game::GetNextDeadline()
+{
+	// Seconds until Update has something to do if there is no input
+
+	if (!IsInitialized()) return GAME_NO_DEADLINE;
+
+	switch (currentGameState)
+	{
+		case GameStates::Stopped:
+			return GAME_NO_DEADLINE;
+		case GameStates::WaitingDecision:
+			// One more update preloads the branches, while the player is still thinking
+			return preloadedDecisionIndex != currentDecisionIndex ? 0.0 : GAME_NO_DEADLINE;
+		case GameStates::WaitingPicture:
+			return std::max(currentPictureEndTime - currentSceneTime, 0.0);
+		default:
+			return 0.0;
+	}
+}
+
 void Game::AdvancePicture()
 {
 	if (!IsInitialized()) return;
 
-	_sceneDef* scene = &gameData->scenes[currentSceneIndex];
+	const SceneNode* scene = &sceneGraph.GetScene(currentSceneIndex);
 
 	if (currentGameState == GameStates::WaitingPicture)
 	{
-		// Calculate elapsed time since beginning of scene
+		// Skip to the end of the current picture
 
-		int16_t startPictureIndex = scene->pictureIndex;
-		int16_t endPictureIndex = startPictureIndex + currentPictureIndex + 1;
-
-		double elapsedTime = 0.0;
-		for (int16_t t = startPictureIndex; t < endPictureIndex; t++)
-		{
-			elapsedTime += gameData->pictures[t].duration / 10.0;
-		}
+		double elapsedTime = sceneGraph.GetPicture(*scene, currentPictureIndex).endTime;
 
 		Audio::SetAudioPlaybackTime(elapsedTime);
 
-		currentWaitTimer = 0;
+		currentSceneTime = elapsedTime;
+		currentWallSceneTime = elapsedTime;
 	}
 	else if (currentGameState == GameStates::WaitingDecision)
 	{
 		if (currentDecisionIndex < 0) return;
 		if (currentDecisionIndex >= scene->numActions) return;
 
-		Log::Print(LogTypes::Info, "Selected decision: %i", currentDecisionIndex + 1);
-		Renderer::GenerateScoreText(std::string());
+		LOG_PRINT(LogTypes::Info, "Selected decision: %i", currentDecisionIndex + 1);
+		currentScoreText.clear();
 
 		currentScore += scene->actions[currentDecisionIndex].scoreDelta;
 		SetNextScene(&scene->actions[currentDecisionIndex]);
 	}
 }
 
-void Game::SetNextScene(const _actionDef* action)
+void Game::SetNextScene(const ActionNode* action)
 {
-	int16_t id = action->nextSceneID;
+	TRACE_ZONE("Game::SetNextScene");
+
+	int32_t nextSceneIndex = action->nextSceneIndex;
 
-	if (id == SCENEID_ENDGAME)
+	if (nextSceneIndex == SCENE_INDEX_ENDGAME)
 	{
 		Stop();
 		return;
 	}
 
-	int16_t nextSceneIndex;
-
-	if (id == SCENEID_PREVDECISION)
+	if (nextSceneIndex == SCENE_INDEX_PREVDECISION)
 	{
 		currentGameState = GameStates::BeginDecision;
 		nextSceneIndex = lastDecisionSceneIndex;
@@ -271,39 +319,76 @@ void Game::SetNextScene(const _actionDef* action)
 			currentGameState = GameStates::BeginDecision;
 		else
 			currentGameState = GameStates::BeginScene;
-
-		nextSceneIndex = GetSceneIndexFromID(id);
 	}
 
-	if (gameData->scenes[currentSceneIndex].numActions > 1) lastDecisionSceneIndex = currentSceneIndex;
+	if (sceneGraph.GetScene(currentSceneIndex).numActions > 1) lastDecisionSceneIndex = currentSceneIndex;
 	currentSceneIndex = nextSceneIndex;
 	currentPictureIndex = 0;
 	currentDecisionIndex = -1;
+	isFrameChanged = true;
+}
+
+void Game::PrefetchPictures(const SceneNode* scene)
+{
+	// Request the current picture and the next ones in the scene,
+	// followed by the decision picture if the scene ends soon.
+
+	std::vector<std::string> paths;
+	int32_t lastPictureIndex = currentPictureIndex + PREFETCH_DEPTH;
+
+	for (int32_t p = currentPictureIndex; p <= lastPictureIndex && p < scene->numPics; p++)
+		AddPicturePath(&sceneGraph.GetPicture(*scene, p).bitmap, &paths);
+
+	if (lastPictureIndex >= scene->numPics && scene->numActions != 1)
+		AddPicturePath(&scene->decisionBmp, &paths);
+
+	PicturePrefetcher::Prefetch(paths);
 }
 
-int16_t Game::GetSceneIndexFromID(const int16_t id)
+void Game::PreloadDecisionBranches(const SceneNode* scene)
 {
-	char sceneName[10];
-#ifdef _MSC_VER
-	sprintf_s(sceneName, sizeof(sceneName), "SC%02d", id);
-#else
-	sprintf(sceneName, "SC%02d", id);
-#endif
-
-	for (int16_t s = 0; s < gameData->numScenes; s++)
+	// While the player is deciding, load the beginning of every scene that
+	// can follow, starting with the highlighted decision. Whatever is not
+	// chosen is dropped when the next scene requests its own pictures.
+
+	std::vector<std::string> picturePaths;
+	std::vector<std::string> wavPaths;
+
+	for (int16_t n = 0; n < scene->numActions; n++)
 	{
-		int32_t result = strcmp(gameData->scenes[s].szSceneFolder, sceneName);
-		if (result == 0)
+		int16_t a = currentDecisionIndex >= 0 ? (currentDecisionIndex + n) % scene->numActions : n;
+		const ActionNode* action = &scene->actions[a];
+
+		if (action->nextSceneIndex == SCENE_INDEX_ENDGAME) continue;
+
+		if (action->nextSceneIndex == SCENE_INDEX_PREVDECISION)
 		{
-			return s;
+			AddPicturePath(&sceneGraph.GetScene(lastDecisionSceneIndex).decisionBmp, &picturePaths);
+			continue;
 		}
+
+		const SceneNode* nextScene = &sceneGraph.GetScene(action->nextSceneIndex);
+
+		if (action->sceneSegment == SEGMENT_DECISION)
+		{
+			AddPicturePath(&nextScene->decisionBmp, &picturePaths);
+			continue;
+		}
+
+		wavPaths.push_back(nextScene->dialogWav.fileName);
+
+		for (int32_t p = 0; p < SPECULATIVE_PICTURES && p < nextScene->numPics; p++)
+			AddPicturePath(&sceneGraph.GetPicture(*nextScene, p).bitmap, &picturePaths);
 	}
 
-	return 0;
+	PicturePrefetcher::Prefetch(picturePaths);
+	Audio::PreloadAudioFromWAV(baseDataPath, wavPaths);
 }
 
-void Game::ToUpperCase(std::string* text)
+void Game::AddPicturePath(const AssetPath* bitmap, std::vector<std::string>* paths)
 {
-	for (auto& c : *text)
-		c = toupper(c);
+	if (Renderer::IsPictureCached(bitmap->filePath)) return;
+	if (std::find(paths->begin(), paths->end(), bitmap->filePath) != paths->end()) return;
+
+	paths->push_back(bitmap->filePath);
 }
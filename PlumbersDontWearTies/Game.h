@@ -1,8 +1,22 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
-#include "GameData.h"
+#include "FrameSnapshot.h"
+#include "SceneGraph.h"
+
+// Number of pictures of each possible next scene loaded while waiting for a decision
+
+constexpr int32_t SPECULATIVE_PICTURES = 2;
+
+// First scene played, the ones before are the PC CD-Rom info screens
+
+constexpr int32_t GAME_START_SCENE_INDEX = 1;
+
+// Returned as the next deadline when only input can change anything
+
+constexpr double GAME_NO_DEADLINE = -1.0;
 
 enum class GameStates
 {
@@ -19,15 +33,28 @@ class Game
 private:
 	std::string baseDataPath = std::string();
 
-	_gameBinFile* gameData = nullptr;
+	SceneGraph sceneGraph = SceneGraph();
 
 	GameStates currentGameState = GameStates::Stopped;
-	int16_t currentSceneIndex = 0;
-	int16_t lastDecisionSceneIndex = 0;
-	int16_t currentPictureIndex = 0;
+	int32_t currentSceneIndex = 0;
+	int32_t lastDecisionSceneIndex = 0;
+	int32_t currentPictureIndex = 0;
 	int8_t currentDecisionIndex = -1;
+	int8_t preloadedDecisionIndex = -2;
 	int32_t currentScore = 0;
-	double currentWaitTimer = 0.0;
+
+	// What is on screen, copied into a FrameSnapshot when it changes
+
+	std::string currentPictureFileName = std::string();
+	std::string currentScoreText = std::string();
+	bool isFrameChanged = true;
+
+	// Picture timing follows the audio clock when there is audio playing.
+	// The wall scene time only accumulates frame times to measure the drift.
+
+	double currentSceneTime = 0.0;
+	double currentWallSceneTime = 0.0;
+	double currentPictureEndTime = 0.0;
 
 public:
 	Game(const std::string baseDataPath);
@@ -36,17 +63,27 @@ public:
 	void Start();
 	void Stop();
 	void Update(const double deltaSeconds);
-	void Render();
+	void GetFrame(FrameSnapshot* frame);
 	void SelectDecision(const int8_t decisionIndex);
 	void SelectNextDecision();
 	void SelectPreviousDecision();
 	void AdvancePicture();
 
+	double GetNextDeadline();
+
+	inline bool HasFrameChanged() { return isFrameChanged; }
+
 	inline bool IsRunning() { return currentGameState != GameStates::Stopped; }
-	inline bool IsInitialized() { return gameData != nullptr; }
+	inline GameStates GetState() { return currentGameState; }
+	inline int32_t GetCurrentSceneIndex() { return currentSceneIndex; }
+	inline int16_t GetNumDecisions() { return sceneGraph.GetScene(currentSceneIndex).numActions; }
+	inline int32_t GetScore() { return currentScore; }
+	inline bool AreDecisionBranchesPreloaded() { return preloadedDecisionIndex == currentDecisionIndex; }
+	inline bool IsInitialized() { return sceneGraph.IsCompiled(); }
 
 private:
-	void SetNextScene(const _actionDef* action);
-	int16_t GetSceneIndexFromID(const int16_t id);
-	void ToUpperCase(std::string* text);
+	void SetNextScene(const ActionNode* action);
+	void PrefetchPictures(const SceneNode* scene);
+	void PreloadDecisionBranches(const SceneNode* scene);
+	void AddPicturePath(const AssetPath* bitmap, std::vector<std::string>* paths);
 };
@@ -63,6 +63,14 @@ struct _pictureDef
 	char        szBitmapFile[14];
 };
 
+struct _gameBinHeader
+{
+	int16_t     unknown1[7];
+	int16_t     numScenes;
+	int16_t     numPics;
+	int16_t     unknown2[2];
+};
+
 struct _gameBinFile
 {
 	int16_t     unknown1[7];
@@ -78,4 +86,41 @@ struct _gameBinFile
 	}
 };
 
+// Extended format, not used by the original game. It has the same structure,
+// but with 32 bit counts and IDs, and the arrays are as big as the counts say.
+// The scenes follow the header and the pictures follow the scenes.
+
+#define GAMEBIN_EX_MAGIC 0x58574450 // "PDWX"
+#define GAMEBIN_EX_VERSION 1
+
+#define SCENEID_EX_ENDGAME 0x7FFFFFFF
+
+struct _actionDefEx
+{
+	int32_t     scoreDelta;
+	int32_t     nextSceneID;       // SCENEID_EX_ENDGAME = end game, SCENEID_PREVDECISION = go back to the last decision
+	int16_t     sceneSegment;
+	_coord      cHotspotTopLeft;
+	_coord      cHotspotBottomRigh;
+};
+
+struct _sceneDefEx
+{
+	int32_t     numPics;
+	int32_t     pictureIndex;
+	int32_t     numActions;
+	char        szSceneFolder[14];
+	char        szDialogWav[14];
+	char        szDecisionBmp[14];
+	_actionDefEx actions[3];
+};
+
+struct _gameBinExHeader
+{
+	uint32_t    magic;
+	uint32_t    version;
+	uint32_t    numScenes;
+	uint32_t    numPics;
+};
+
 #pragma pack(pop)
\ No newline at end of file
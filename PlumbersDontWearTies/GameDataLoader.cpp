@@ -0,0 +1,193 @@
+#include "GameDataLoader.h"
+
+#include <cstring>
+
+#include "Log.h"
+
+// In the original format the arrays have a fixed position, so there is
+// no room for more scenes, but the pictures can continue to the end.
+
+constexpr size_t GAMEBIN_SCENES_OFFSET = offsetof(_gameBinFile, scenes);
+constexpr size_t GAMEBIN_PICTURES_OFFSET = offsetof(_gameBinFile, pictures);
+constexpr int32_t GAMEBIN_MAX_SCENES = sizeof(_gameBinFile::scenes) / sizeof(_sceneDef);
+
+bool GameDataLoader::Load(const uint8_t* data, const size_t size, GameDefinition* definition)
+{
+	definition->scenes.clear();
+	definition->pictures.clear();
+
+	uint32_t magic = 0;
+	if (size >= sizeof(magic)) memcpy(&magic, data, sizeof(magic));
+
+	if (magic == GAMEBIN_EX_MAGIC)
+		return LoadExtended(data, size, definition);
+	else
+		return LoadClassic(data, size, definition);
+}
+
+bool GameDataLoader::SaveClassic(const GameDefinition& definition, std::vector<uint8_t>* data)
+{
+	// Only possible if everything fits in the original limits
+
+	if (definition.scenes.size() > static_cast<size_t>(GAMEBIN_MAX_SCENES) || definition.pictures.size() > INT16_MAX) return false;
+
+	data->assign(GAMEBIN_PICTURES_OFFSET + definition.pictures.size() * sizeof(_pictureDef), 0);
+
+	_gameBinHeader header;
+	memset(&header, 0, sizeof(header));
+	header.numScenes = static_cast<int16_t>(definition.scenes.size());
+	header.numPics = static_cast<int16_t>(definition.pictures.size());
+	memcpy(data->data(), &header, sizeof(header));
+
+	for (size_t s = 0; s < definition.scenes.size(); s++)
+	{
+		const _sceneDefEx* sceneEx = &definition.scenes[s];
+
+		if (sceneEx->numPics > INT16_MAX || sceneEx->pictureIndex > INT16_MAX || sceneEx->numActions > INT16_MAX) return false;
+
+		_sceneDef scene;
+		scene.numPics = static_cast<int16_t>(sceneEx->numPics);
+		scene.pictureIndex = static_cast<int16_t>(sceneEx->pictureIndex);
+		scene.numActions = static_cast<int16_t>(sceneEx->numActions);
+		memcpy(scene.szSceneFolder, sceneEx->szSceneFolder, sizeof(scene.szSceneFolder));
+		memcpy(scene.szDialogWav, sceneEx->szDialogWav, sizeof(scene.szDialogWav));
+		memcpy(scene.szDecisionBmp, sceneEx->szDecisionBmp, sizeof(scene.szDecisionBmp));
+
+		for (int32_t a = 0; a < 3; a++)
+		{
+			const _actionDefEx* actionEx = &sceneEx->actions[a];
+			int32_t nextSceneID = actionEx->nextSceneID == SCENEID_EX_ENDGAME ? SCENEID_ENDGAME : actionEx->nextSceneID;
+
+			if (nextSceneID > INT16_MAX || nextSceneID < INT16_MIN || (nextSceneID == SCENEID_ENDGAME && actionEx->nextSceneID != SCENEID_EX_ENDGAME)) return false;
+
+			scene.actions[a].scoreDelta = actionEx->scoreDelta;
+			scene.actions[a].nextSceneID = static_cast<int16_t>(nextSceneID);
+			scene.actions[a].sceneSegment = actionEx->sceneSegment;
+			scene.actions[a].cHotspotTopLeft = actionEx->cHotspotTopLeft;
+			scene.actions[a].cHotspotBottomRigh = actionEx->cHotspotBottomRigh;
+		}
+
+		memcpy(data->data() + GAMEBIN_SCENES_OFFSET + s * sizeof(_sceneDef), &scene, sizeof(scene));
+	}
+
+	if (!definition.pictures.empty()) memcpy(data->data() + GAMEBIN_PICTURES_OFFSET, definition.pictures.data(), definition.pictures.size() * sizeof(_pictureDef));
+
+	return true;
+}
+
+void GameDataLoader::SaveExtended(const GameDefinition& definition, std::vector<uint8_t>* data)
+{
+	_gameBinExHeader header;
+	header.magic = GAMEBIN_EX_MAGIC;
+	header.version = GAMEBIN_EX_VERSION;
+	header.numScenes = static_cast<uint32_t>(definition.scenes.size());
+	header.numPics = static_cast<uint32_t>(definition.pictures.size());
+
+	size_t scenesSize = definition.scenes.size() * sizeof(_sceneDefEx);
+	size_t picturesSize = definition.pictures.size() * sizeof(_pictureDef);
+
+	data->resize(sizeof(header) + scenesSize + picturesSize);
+	memcpy(data->data(), &header, sizeof(header));
+	if (scenesSize > 0) memcpy(data->data() + sizeof(header), definition.scenes.data(), scenesSize);
+	if (picturesSize > 0) memcpy(data->data() + sizeof(header) + scenesSize, definition.pictures.data(), picturesSize);
+}
+
+bool GameDataLoader::LoadClassic(const uint8_t* data, const size_t size, GameDefinition* definition)
+{
+	if (size < sizeof(_gameBinHeader))
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN is too small (%zu bytes).", size);
+		return false;
+	}
+
+	_gameBinHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	if (header.numScenes < 0 || header.numScenes > GAMEBIN_MAX_SCENES || header.numPics < 0)
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN has an invalid number of scenes (%i) or pictures (%i).", header.numScenes, header.numPics);
+		return false;
+	}
+
+	// Only read what the counts say, and only if the file has it
+
+	if (GAMEBIN_SCENES_OFFSET + header.numScenes * sizeof(_sceneDef) > size || (header.numPics > 0 && GAMEBIN_PICTURES_OFFSET + header.numPics * sizeof(_pictureDef) > size))
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN is truncated: %i scenes and %i pictures don't fit in %zu bytes.", header.numScenes, header.numPics, size);
+		return false;
+	}
+
+	definition->scenes.resize(header.numScenes);
+
+	for (int32_t s = 0; s < header.numScenes; s++)
+	{
+		_sceneDef scene;
+		memcpy(&scene, data + GAMEBIN_SCENES_OFFSET + s * sizeof(_sceneDef), sizeof(_sceneDef));
+
+		_sceneDefEx* sceneEx = &definition->scenes[s];
+		sceneEx->numPics = scene.numPics;
+		sceneEx->pictureIndex = scene.pictureIndex;
+		sceneEx->numActions = scene.numActions;
+		memcpy(sceneEx->szSceneFolder, scene.szSceneFolder, sizeof(sceneEx->szSceneFolder));
+		memcpy(sceneEx->szDialogWav, scene.szDialogWav, sizeof(sceneEx->szDialogWav));
+		memcpy(sceneEx->szDecisionBmp, scene.szDecisionBmp, sizeof(sceneEx->szDecisionBmp));
+
+		for (int32_t a = 0; a < 3; a++)
+		{
+			_actionDefEx* actionEx = &sceneEx->actions[a];
+			actionEx->scoreDelta = scene.actions[a].scoreDelta;
+			actionEx->nextSceneID = scene.actions[a].nextSceneID == SCENEID_ENDGAME ? SCENEID_EX_ENDGAME : scene.actions[a].nextSceneID;
+			actionEx->sceneSegment = scene.actions[a].sceneSegment;
+			actionEx->cHotspotTopLeft = scene.actions[a].cHotspotTopLeft;
+			actionEx->cHotspotBottomRigh = scene.actions[a].cHotspotBottomRigh;
+		}
+	}
+
+	definition->pictures.resize(header.numPics);
+	if (header.numPics > 0) memcpy(definition->pictures.data(), data + GAMEBIN_PICTURES_OFFSET, header.numPics * sizeof(_pictureDef));
+
+	return true;
+}
+
+bool GameDataLoader::LoadExtended(const uint8_t* data, const size_t size, GameDefinition* definition)
+{
+	if (size < sizeof(_gameBinExHeader))
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN is too small (%zu bytes).", size);
+		return false;
+	}
+
+	_gameBinExHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	if (header.version != GAMEBIN_EX_VERSION)
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN has an unsupported version (%u).", header.version);
+		return false;
+	}
+
+	// Counts are used as signed indices
+
+	if (header.numScenes > INT32_MAX || header.numPics > INT32_MAX)
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN has an invalid number of scenes (%u) or pictures (%u).", header.numScenes, header.numPics);
+		return false;
+	}
+
+	uint64_t scenesSize = static_cast<uint64_t>(header.numScenes) * sizeof(_sceneDefEx);
+	uint64_t picturesSize = static_cast<uint64_t>(header.numPics) * sizeof(_pictureDef);
+
+	if (sizeof(header) + scenesSize + picturesSize > size)
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN is truncated: %u scenes and %u pictures don't fit in %zu bytes.", header.numScenes, header.numPics, size);
+		return false;
+	}
+
+	definition->scenes.resize(header.numScenes);
+	definition->pictures.resize(header.numPics);
+
+	if (scenesSize > 0) memcpy(definition->scenes.data(), data + sizeof(header), static_cast<size_t>(scenesSize));
+	if (picturesSize > 0) memcpy(definition->pictures.data(), data + sizeof(header) + scenesSize, static_cast<size_t>(picturesSize));
+
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "GameData.h"
+
+// Scenes and pictures of GAME.BIN, in arrays as big as the file says.
+// Both formats are loaded into the structures of the extended one.
+
+struct GameDefinition
+{
+	std::vector<_sceneDefEx> scenes;
+	std::vector<_pictureDef> pictures;
+};
+
+class GameDataLoader
+{
+public:
+	static bool Load(const uint8_t* data, const size_t size, GameDefinition* definition);
+	static bool SaveClassic(const GameDefinition& definition, std::vector<uint8_t>* data);
+	static void SaveExtended(const GameDefinition& definition, std::vector<uint8_t>* data);
+
+private:
+	static bool LoadClassic(const uint8_t* data, const size_t size, GameDefinition* definition);
+	static bool LoadExtended(const uint8_t* data, const size_t size, GameDefinition* definition);
+};
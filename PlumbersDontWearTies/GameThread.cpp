@@ -0,0 +1,155 @@
+#include "GameThread.h"
+
+#include <chrono>
+
+#include "Game.h"
+#include "Log.h"
+#include "Trace.h"
+
+Game* GameThread::game = nullptr;
+std::thread GameThread::thread = std::thread();
+std::mutex GameThread::mutex;
+std::condition_variable GameThread::inputCondition;
+std::vector<GameInput> GameThread::pendingInputs = std::vector<GameInput>();
+bool GameThread::isRunning = false;
+
+TripleBuffer<FrameSnapshot> GameThread::frames;
+Uint32 GameThread::frameEventType = static_cast<Uint32>(-1);
+
+bool GameThread::Initialize(Game* game)
+{
+	if (isRunning) return true;
+
+	frameEventType = SDL_RegisterEvents(1);
+
+	if (frameEventType == static_cast<Uint32>(-1))
+	{
+		LOG_PRINT(LogTypes::Critical, "Can't register the frame event: %s", SDL_GetError());
+		return false;
+	}
+
+	GameThread::game = game;
+	pendingInputs.clear();
+
+	// The first frame is there before the thread starts, so the main
+	// thread knows right away whether the game is running at all
+
+	PublishFrame();
+
+	isRunning = true;
+	thread = std::thread(ThreadLoop);
+
+	return true;
+}
+
+void GameThread::Dispose()
+{
+	if (!isRunning) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isRunning = false;
+	}
+
+	inputCondition.notify_all();
+	thread.join();
+
+	game = nullptr;
+}
+
+void GameThread::PostInput(const GameInputs type, const int8_t decisionIndex)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingInputs.push_back({ type, decisionIndex });
+	}
+
+	inputCondition.notify_all();
+}
+
+void GameThread::ThreadLoop()
+{
+	Trace::SetThreadName("Game");
+
+	std::vector<GameInput> inputs;
+	Uint64 previousTime = SDL_GetPerformanceCounter();
+	bool isUpdateDue = false;
+
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!isRunning) break;
+
+			// Input waits for the updates the game wants right away, so a
+			// decision confirmed in the same batch still gets its branches preloaded
+
+			if (!isUpdateDue) inputs.swap(pendingInputs);
+		}
+
+		for (const GameInput& input : inputs)
+			ApplyInput(input);
+
+		inputs.clear();
+
+		Uint64 currentTime = SDL_GetPerformanceCounter();
+		double deltaSeconds = (currentTime - previousTime) / (double)SDL_GetPerformanceFrequency();
+		previousTime = currentTime;
+
+		{
+			TRACE_ZONE("Game::Update");
+			game->Update(deltaSeconds);
+		}
+
+		if (game->HasFrameChanged()) PublishFrame();
+
+		// Sleep until the next deadline of the game or new input
+
+		double deadline = game->GetNextDeadline();
+		isUpdateDue = deadline == 0.0;
+		if (isUpdateDue) continue;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		auto hasWork = [] { return !isRunning || !pendingInputs.empty(); };
+
+		if (deadline < 0.0)
+			inputCondition.wait(lock, hasWork);
+		else
+			inputCondition.wait_for(lock, std::chrono::duration<double>(deadline), hasWork);
+	}
+}
+
+void GameThread::ApplyInput(const GameInput& input)
+{
+	switch (input.type)
+	{
+		case GameInputs::Stop:
+			game->Stop();
+			break;
+		case GameInputs::SelectDecision:
+			game->SelectDecision(input.decisionIndex);
+			break;
+		case GameInputs::SelectNextDecision:
+			game->SelectNextDecision();
+			break;
+		case GameInputs::SelectPreviousDecision:
+			game->SelectPreviousDecision();
+			break;
+		case GameInputs::AdvancePicture:
+			game->AdvancePicture();
+			break;
+	}
+}
+
+void GameThread::PublishFrame()
+{
+	game->GetFrame(frames.GetBack());
+	frames.Publish();
+
+	SDL_Event event;
+	SDL_zero(event);
+	event.type = frameEventType;
+
+	if (SDL_PushEvent(&event) < 0)
+		LOG_PRINT(LogTypes::Warning, "Can't push the frame event: %s", SDL_GetError());
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include "FrameSnapshot.h"
+#include "TripleBuffer.h"
+
+class Game;
+
+enum class GameInputs
+{
+	Stop,
+	SelectDecision,
+	SelectNextDecision,
+	SelectPreviousDecision,
+	AdvancePicture
+};
+
+struct GameInput
+{
+	GameInputs type;
+	int8_t decisionIndex; // Only for SelectDecision
+};
+
+// Runs the game on its own thread, so waiting for pictures and audio never
+// holds back the main thread, which keeps handling events and presenting.
+// Input is queued for the game thread, and every change of what is on screen
+// is published as a FrameSnapshot through a triple buffer, followed by an SDL
+// event that wakes the main thread up.
+
+class GameThread
+{
+private:
+	static Game* game;
+	static std::thread thread;
+	static std::mutex mutex;
+	static std::condition_variable inputCondition;
+	static std::vector<GameInput> pendingInputs;
+	static bool isRunning;
+
+	static TripleBuffer<FrameSnapshot> frames;
+	static Uint32 frameEventType;
+
+public:
+	static bool Initialize(Game* game);
+	static void Dispose();
+
+	static void PostInput(const GameInputs type, const int8_t decisionIndex = -1);
+
+	// Main thread side, AcquireFrame returns false if the frame didn't change
+
+	inline static bool AcquireFrame() { return frames.Acquire(); }
+	inline static const FrameSnapshot& GetFrame() { return frames.GetFront(); }
+
+private:
+	static void ThreadLoop();
+	static void ApplyInput(const GameInput& input);
+	static void PublishFrame();
+};
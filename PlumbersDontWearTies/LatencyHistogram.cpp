@@ -0,0 +1,77 @@
+#include "LatencyHistogram.h"
+
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+void LatencyHistogram::Record(const uint64_t microseconds)
+{
+	uint64_t value = microseconds < HISTOGRAM_MAX_VALUE ? microseconds : HISTOGRAM_MAX_VALUE;
+
+	counts[GetBucketIndex(value)]++;
+	totalCount++;
+	totalValue += value;
+	if (value > maxValue) maxValue = value;
+}
+
+void LatencyHistogram::Reset()
+{
+	memset(counts, 0, sizeof(counts));
+	totalCount = 0;
+	totalValue = 0;
+	maxValue = 0;
+}
+
+uint64_t LatencyHistogram::GetPercentile(const double percentile) const
+{
+	if (totalCount == 0) return 0;
+
+	// Highest value of the bucket where the percentile falls, but never above the real maximum
+
+	uint64_t target = static_cast<uint64_t>(percentile / 100.0 * totalCount + 0.5);
+	if (target < 1) target = 1;
+	if (target > totalCount) target = totalCount;
+
+	uint64_t accumulated = 0;
+
+	for (int32_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+	{
+		accumulated += counts[b];
+
+		if (accumulated >= target)
+		{
+			uint64_t value = GetBucketMaxValue(b);
+			return value < maxValue ? value : maxValue;
+		}
+	}
+
+	return maxValue;
+}
+
+int32_t LatencyHistogram::GetBucketIndex(const uint64_t value)
+{
+	if (value < 2 * HISTOGRAM_SUB_BUCKETS) return static_cast<int32_t>(value);
+
+	// The top bits of the value choose the sub-bucket of its power of two
+
+	int32_t highestBit = 0;
+	while ((value >> (highestBit + 1)) != 0) highestBit++;
+
+	int32_t shift = highestBit - HISTOGRAM_SUB_BUCKET_BITS;
+	int32_t subBucket = static_cast<int32_t>(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+
+	return 2 * HISTOGRAM_SUB_BUCKETS + (shift - 1) * HISTOGRAM_SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::GetBucketMaxValue(const int32_t index)
+{
+	if (index < 2 * HISTOGRAM_SUB_BUCKETS) return static_cast<uint64_t>(index);
+
+	int32_t shift = (index - 2 * HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS + 1;
+	int32_t subBucket = (index - 2 * HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+
+	return (static_cast<uint64_t>(HISTOGRAM_SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
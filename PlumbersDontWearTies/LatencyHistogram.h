@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// Histogram of durations in microseconds with a constant relative precision,
+// like HDR histograms: values below 32 us are exact, and above that every
+// power of two is split in 16 buckets, so any value is within 6.25%.
+
+constexpr int32_t HISTOGRAM_SUB_BUCKET_BITS = 4;
+constexpr int32_t HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+constexpr int32_t HISTOGRAM_MAX_SHIFT = 26; // values up to 2^31 us, about 35 minutes
+constexpr int32_t HISTOGRAM_BUCKETS = 2 * HISTOGRAM_SUB_BUCKETS + HISTOGRAM_MAX_SHIFT * HISTOGRAM_SUB_BUCKETS;
+constexpr uint64_t HISTOGRAM_MAX_VALUE = (1ULL << (HISTOGRAM_MAX_SHIFT + HISTOGRAM_SUB_BUCKET_BITS + 1)) - 1;
+
+class LatencyHistogram
+{
+private:
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t totalCount;
+	uint64_t totalValue;
+	uint64_t maxValue;
+
+public:
+	LatencyHistogram();
+
+	void Record(const uint64_t microseconds);
+	void Reset();
+
+	uint64_t GetPercentile(const double percentile) const;
+	inline uint64_t GetCount() const { return totalCount; }
+	inline uint64_t GetMax() const { return maxValue; }
+	inline double GetMean() const { return totalCount > 0 ? totalValue / static_cast<double>(totalCount) : 0.0; }
+
+private:
+	static int32_t GetBucketIndex(const uint64_t value);
+	static uint64_t GetBucketMaxValue(const int32_t index);
+};
@@ -1,27 +1,169 @@
 #include "Log.h"
 
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
 #include <SDL.h>
 
-void Log::Print(LogTypes type, const char* message, ...)
+Log::Record Log::records[LOG_QUEUE_SIZE];
+std::atomic<size_t> Log::writePosition(0);
+size_t Log::readPosition = 0;
+std::atomic<uint64_t> Log::droppedRecords(0);
+uint64_t Log::reportedDroppedRecords = 0;
+std::atomic<uint32_t> Log::activeWriters(0);
+
+std::thread Log::writerThread = std::thread();
+std::atomic<bool> Log::isRunning(false);
+
+void Log::Initialize()
+{
+	if (isRunning) return;
+
+	// Each slot can be written when its sequence is the write position that
+	// reaches it, and read when it is that position plus one
+
+	for (size_t r = 0; r < LOG_QUEUE_SIZE; r++)
+		records[r].sequence.store(r, std::memory_order_relaxed);
+
+	writePosition.store(0, std::memory_order_relaxed);
+	readPosition = 0;
+	droppedRecords.store(0, std::memory_order_relaxed);
+	reportedDroppedRecords = 0;
+
+	isRunning.store(true, std::memory_order_release);
+	writerThread = std::thread(WriterLoop);
+}
+
+void Log::Dispose()
+{
+	if (!isRunning) return;
+
+	isRunning.store(false);
+	if (writerThread.joinable()) writerThread.join();
+
+	// A writer that still saw the ring open may not have finished its slot.
+	// Both sides use sequentially consistent operations, so either it sees
+	// the ring closed and writes right away, or it is counted here.
+
+	while (activeWriters.load() != 0)
+		std::this_thread::yield();
+
+	// Whatever was written after the last flush of the writer thread
+
+	Flush();
+	ReportDroppedRecords();
+}
+
+void Log::Write(const LogTypes type, const char* message, ...)
 {
 	va_list args;
 	va_start(args, message);
 
+	activeWriters++;
+
+	if (!isRunning.load())
+	{
+		activeWriters--;
+
+		char text[LOG_MESSAGE_SIZE];
+		vsnprintf(text, sizeof(text), message, args);
+		va_end(args);
+
+		Emit(type, text);
+		return;
+	}
+
+	// Claim a slot, or drop the message if the writer thread is a whole ring behind
+
+	size_t position = writePosition.load(std::memory_order_relaxed);
+	Record* record;
+
+	while (true)
+	{
+		record = &records[position & (LOG_QUEUE_SIZE - 1)];
+		size_t sequence = record->sequence.load(std::memory_order_acquire);
+		intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+		if (difference == 0)
+		{
+			if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+		}
+		else if (difference < 0)
+		{
+			va_end(args);
+			droppedRecords.fetch_add(1, std::memory_order_relaxed);
+			activeWriters--;
+			return;
+		}
+		else
+		{
+			position = writePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	record->type = type;
+	vsnprintf(record->message, sizeof(record->message), message, args);
+	va_end(args);
+
+	record->sequence.store(position + 1, std::memory_order_release);
+	activeWriters--;
+}
+
+void Log::WriterLoop()
+{
+	while (isRunning.load(std::memory_order_acquire))
+	{
+		Flush();
+		ReportDroppedRecords();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL));
+	}
+}
+
+void Log::Flush()
+{
+	while (true)
+	{
+		Record* record = &records[readPosition & (LOG_QUEUE_SIZE - 1)];
+
+		// Stop at the first slot that is empty or still being written
+		if (record->sequence.load(std::memory_order_acquire) != readPosition + 1) break;
+
+		Emit(record->type, record->message);
+
+		record->sequence.store(readPosition + LOG_QUEUE_SIZE, std::memory_order_release);
+		readPosition++;
+	}
+}
+
+void Log::ReportDroppedRecords()
+{
+	uint64_t dropped = droppedRecords.load(std::memory_order_relaxed);
+	if (dropped == reportedDroppedRecords) return;
+
+	char text[LOG_MESSAGE_SIZE];
+	snprintf(text, sizeof(text), "%llu log messages have been dropped, %llu in total.", static_cast<unsigned long long>(dropped - reportedDroppedRecords), static_cast<unsigned long long>(dropped));
+	Emit(LogTypes::Warning, text);
+
+	reportedDroppedRecords = dropped;
+}
+
+void Log::Emit(const LogTypes type, const char* text)
+{
 	switch (type)
 	{
 		case LogTypes::Info:
-			SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, message, args);
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "%s", text);
 			break;
 		case LogTypes::Warning:
-			SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, message, args);
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "%s", text);
 			break;
 		case LogTypes::Error:
-			SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, message, args);
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "%s", text);
 			break;
 		case LogTypes::Critical:
-			SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_CRITICAL, message, args);
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_CRITICAL, "%s", text);
 			break;
 	}
-
-	va_end(args);
 }
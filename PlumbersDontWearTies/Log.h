@@ -1,5 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "Config.h"
+
 enum class LogTypes
 {
 	Info,
@@ -8,8 +15,55 @@ enum class LogTypes
 	Critical
 };
 
+// Messages are written by a background thread, so logging doesn't block the
+// game or audio threads on console output
+
+constexpr size_t LOG_QUEUE_SIZE = 1024; // messages, must be a power of two
+constexpr size_t LOG_MESSAGE_SIZE = 256; // bytes, longer messages are truncated
+constexpr int32_t LOG_FLUSH_INTERVAL = 10; // milliseconds
+
+// Messages below LOG_MIN_LEVEL are removed at compile time along with their
+// arguments, which is why this is a macro: a function would evaluate them first
+
+#define LOG_PRINT(type, ...) do { if (static_cast<int32_t>(type) >= LOG_MIN_LEVEL) Log::Write(type, __VA_ARGS__); } while (0)
+
+// Callers format their message into a slot of a lock-free ring shared by all
+// threads, and the writer thread passes it to SDL. When the ring is full the
+// message is dropped and counted. Before Initialize and after Dispose
+// messages are written right away, which is what the tools use.
+
 class Log
 {
+private:
+	struct Record
+	{
+		std::atomic<size_t> sequence;
+		LogTypes type;
+		char message[LOG_MESSAGE_SIZE];
+	};
+
+	static Record records[LOG_QUEUE_SIZE];
+	static std::atomic<size_t> writePosition;
+	static size_t readPosition; // Only used by the writer thread
+	static std::atomic<uint64_t> droppedRecords;
+	static uint64_t reportedDroppedRecords;
+	static std::atomic<uint32_t> activeWriters; // Writing into the ring, Dispose waits for them
+
+	static std::thread writerThread;
+	static std::atomic<bool> isRunning;
+
 public:
-	static void Print(LogTypes type, const char* message, ...);
+	static void Initialize();
+	static void Dispose();
+
+	// Use LOG_PRINT, which leaves out the messages below LOG_MIN_LEVEL
+	static void Write(const LogTypes type, const char* message, ...);
+
+	inline static uint64_t GetDroppedRecords() { return droppedRecords.load(std::memory_order_relaxed); }
+
+private:
+	static void WriterLoop();
+	static void Flush();
+	static void ReportDroppedRecords();
+	static void Emit(const LogTypes type, const char* text);
 };
@@ -0,0 +1,139 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr size_t MAPPED_FILE_PAGE_SIZE = 4096;
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	isView = false;
+
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+	if (fileDescriptor < 0) return false;
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) < 0 || fileStat.st_size == 0)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+
+	if (mapping == MAP_FAILED) return false;
+
+	data = static_cast<const uint8_t*>(mapping);
+	size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+bool MappedFile::OpenView(const uint8_t* data, const size_t size)
+{
+	Close();
+
+	if (data == nullptr || size == 0) return false;
+
+	MappedFile::data = data;
+	MappedFile::size = size;
+	isView = true;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (isView)
+	{
+		// The memory belongs to someone else
+
+		data = nullptr;
+		size = 0;
+		isView = false;
+		return;
+	}
+
+#ifdef _WIN32
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+void MappedFile::Touch(const size_t offset, const size_t length) const
+{
+	// Read one byte of every page, so they are loaded from disk
+	// by this thread and not by whoever reads them later.
+
+	if (data == nullptr || offset >= size) return;
+
+	size_t end = offset + length < size ? offset + length : size;
+	volatile uint8_t sink = 0;
+
+	for (size_t p = offset; p < end; p += MAPPED_FILE_PAGE_SIZE)
+		sink ^= data[p];
+
+	(void)sink;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file, or a view of memory
+// mapped by someone else, like a file inside an archive.
+
+class MappedFile
+{
+private:
+	const uint8_t* data;
+	size_t size;
+	bool isView;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filePath);
+	bool OpenView(const uint8_t* data, const size_t size);
+	void Close();
+	void Touch(const size_t offset, const size_t length) const;
+
+	inline const uint8_t* GetData() const { return data; }
+	inline size_t GetSize() const { return size; }
+	inline bool IsOpen() const { return data != nullptr; }
+};
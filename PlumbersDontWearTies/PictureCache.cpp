@@ -0,0 +1,370 @@
+#include "PictureCache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <sys/stat.h>
+
+#include "AssetArchive.h"
+#include "Log.h"
+#include "RendererProbe.h"
+
+std::string PictureCache::folderPath = std::string();
+uint64_t PictureCache::budgetBytes = PICTURE_CACHE_DEFAULT_BUDGET;
+std::atomic<uint64_t> PictureCache::usedBytes(0);
+std::atomic<uint32_t> PictureCache::hits(0);
+std::atomic<uint32_t> PictureCache::misses(0);
+std::atomic<uint32_t> PictureCache::writes(0);
+std::atomic<uint32_t> PictureCache::temporaryFiles(0);
+
+bool PictureCache::Initialize()
+{
+	if (IsInitialized() || budgetBytes == 0) return false;
+
+	char* prefPath = SDL_GetPrefPath(PREF_ORGANIZATION, PREF_APPLICATION);
+
+	if (prefPath == nullptr)
+	{
+		LOG_PRINT(LogTypes::Warning, "There is no folder to keep the picture cache in: %s", SDL_GetError());
+		return false;
+	}
+
+	std::string path = std::string(prefPath) + PICTURE_CACHE_FOLDER_NAME;
+	SDL_free(prefPath);
+
+	if (!CreateFolder(path))
+	{
+		LOG_PRINT(LogTypes::Warning, "Can't create the picture cache folder %s", path.c_str());
+		return false;
+	}
+
+	folderPath = path + "/";
+	hits = 0;
+	misses = 0;
+	writes = 0;
+
+	CleanFolder();
+
+	LOG_PRINT(LogTypes::Info, "Using the picture cache in %s, %.1f of %.1f MB used.", folderPath.c_str(), usedBytes.load() / (1024.0 * 1024.0), budgetBytes / (1024.0 * 1024.0));
+
+	return true;
+}
+
+void PictureCache::Dispose()
+{
+	if (!IsInitialized()) return;
+
+	folderPath.clear();
+
+	LOG_PRINT(LogTypes::Info, "Picture cache stats: %u hits, %u misses, %u written.", hits.load(), misses.load(), writes.load());
+}
+
+void PictureCache::SetBudget(const uint64_t bytes)
+{
+	budgetBytes = bytes;
+	LOG_PRINT(LogTypes::Info, "Picture cache budget set to %.1f MB.", bytes / (1024.0 * 1024.0));
+}
+
+SDL_Surface* PictureCache::Open(const std::string& filePath, const uint32_t pixelFormat, MappedFile* file)
+{
+	if (!IsInitialized()) return nullptr;
+
+	uint64_t sourceSize;
+	int64_t sourceModifiedTime;
+
+	if (filePath.size() >= PICTURE_CACHE_PATH_SIZE || !GetSourceInfo(filePath, &sourceSize, &sourceModifiedTime) || !file->Open(GetEntryPath(filePath, pixelFormat)))
+	{
+		misses++;
+		return nullptr;
+	}
+
+	// An entry of another source, a stale one or a truncated one is a miss
+	// and gets replaced once the picture has been decoded again
+
+	const uint8_t* data = file->GetData();
+	size_t size = file->GetSize();
+
+	PictureCacheHeader header;
+	bool isValid = size >= PICTURE_CACHE_ALIGNMENT;
+
+	if (isValid)
+	{
+		memcpy(&header, data, sizeof(PictureCacheHeader));
+
+		isValid = header.magic == PICTURE_CACHE_MAGIC && header.version == PICTURE_CACHE_VERSION && header.pixelFormat == pixelFormat &&
+			header.sourceSize == sourceSize && header.sourceModifiedTime == sourceModifiedTime &&
+			strncmp(header.sourcePath, filePath.c_str(), PICTURE_CACHE_PATH_SIZE) == 0 &&
+			header.width > 0 && header.height > 0 && static_cast<int64_t>(header.pitch) >= static_cast<int64_t>(header.width) * 4 &&
+			static_cast<uint64_t>(header.pitch) * static_cast<uint64_t>(header.height) <= size - PICTURE_CACHE_ALIGNMENT;
+	}
+
+	SDL_Surface* surface = nullptr;
+
+	if (isValid)
+	{
+		// SDL only reads the pixels of a surface it doesn't own, so the mapping can be read-only
+		void* pixels = const_cast<uint8_t*>(data + PICTURE_CACHE_ALIGNMENT);
+		surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, header.width, header.height, 32, header.pitch, pixelFormat);
+	}
+
+	if (surface == nullptr)
+	{
+		file->Close();
+		misses++;
+		return nullptr;
+	}
+
+	hits++;
+	return surface;
+}
+
+SDL_Surface* PictureCache::Load(const std::string& filePath, const uint32_t pixelFormat)
+{
+	MappedFile file;
+	SDL_Surface* mappedSurface = Open(filePath, pixelFormat, &file);
+	if (mappedSurface == nullptr) return nullptr;
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, mappedSurface->w, mappedSurface->h, 32, pixelFormat);
+
+	if (surface != nullptr)
+	{
+		const uint8_t* source = static_cast<const uint8_t*>(mappedSurface->pixels);
+		uint8_t* target = static_cast<uint8_t*>(surface->pixels);
+		size_t rowSize = static_cast<size_t>(surface->w) * 4;
+
+		for (int32_t y = 0; y < surface->h; y++)
+			memcpy(target + static_cast<size_t>(y) * surface->pitch, source + static_cast<size_t>(y) * mappedSurface->pitch, rowSize);
+	}
+
+	SDL_FreeSurface(mappedSurface);
+
+	return surface;
+}
+
+void PictureCache::Save(const std::string& filePath, const SDL_Surface* surface)
+{
+	if (!IsInitialized() || surface->format->BytesPerPixel != 4 || filePath.size() >= PICTURE_CACHE_PATH_SIZE) return;
+
+	PictureCacheHeader header;
+	memset(&header, 0, sizeof(PictureCacheHeader));
+
+	if (!GetSourceInfo(filePath, &header.sourceSize, &header.sourceModifiedTime)) return;
+
+	header.magic = PICTURE_CACHE_MAGIC;
+	header.version = PICTURE_CACHE_VERSION;
+	header.pixelFormat = surface->format->format;
+	header.width = surface->w;
+	header.height = surface->h;
+	header.pitch = surface->pitch;
+	memcpy(header.sourcePath, filePath.c_str(), filePath.size());
+
+	// Replacing a stale entry counts it twice until the next launch, which
+	// only makes the cache stop filling a little earlier
+
+	uint64_t entrySize = PICTURE_CACHE_ALIGNMENT + static_cast<uint64_t>(surface->pitch) * surface->h;
+	if (usedBytes.load() + entrySize > budgetBytes) return;
+
+	std::vector<char> padding(PICTURE_CACHE_ALIGNMENT - sizeof(PictureCacheHeader), 0);
+
+	// Written under a name of its own and renamed when complete, so a reader
+	// never maps half an entry and two threads saving the same picture don't collide
+
+	std::string entryPath = GetEntryPath(filePath, header.pixelFormat);
+	std::string temporaryPath = entryPath + "." + std::to_string(temporaryFiles++) + ".tmp";
+
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(PictureCacheHeader));
+		file.write(padding.data(), padding.size());
+		file.write(static_cast<const char*>(surface->pixels), static_cast<std::streamsize>(surface->pitch) * surface->h);
+
+		if (!file.good())
+		{
+			file.close();
+			remove(temporaryPath.c_str());
+			LOG_PRINT(LogTypes::Warning, "Can't write %s to the picture cache", filePath.c_str());
+			return;
+		}
+	}
+
+#ifdef _WIN32
+	// Renaming doesn't replace an existing file on Windows
+	remove(entryPath.c_str());
+#endif
+
+	if (rename(temporaryPath.c_str(), entryPath.c_str()) != 0)
+	{
+		remove(temporaryPath.c_str());
+		LOG_PRINT(LogTypes::Warning, "Can't write %s to the picture cache", filePath.c_str());
+		return;
+	}
+
+	usedBytes += entrySize;
+	writes++;
+}
+
+std::string PictureCache::GetEntryPath(const std::string& filePath, const uint32_t pixelFormat)
+{
+	// 64 bit FNV-1a of the path and the pixel format
+
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (char c : filePath)
+		hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+
+	for (int32_t b = 0; b < 4; b++)
+		hash = (hash ^ ((pixelFormat >> (b * 8)) & 0xFF)) * 1099511628211ULL;
+
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.pic", static_cast<unsigned long long>(hash));
+
+	return folderPath + name;
+}
+
+bool PictureCache::GetSourceInfo(const std::string& filePath, uint64_t* size, int64_t* modifiedTime)
+{
+	// A picture in the archive changes when the archive does
+
+	const uint8_t* archivedData;
+	size_t archivedSize;
+
+	bool isArchived = AssetArchive::Find(filePath, &archivedData, &archivedSize);
+
+	if (!GetFileInfo(isArchived ? AssetArchive::GetArchivePath() : filePath, size, modifiedTime)) return false;
+	if (isArchived) *size = archivedSize;
+
+	return true;
+}
+
+bool PictureCache::IsEntryUsable(const std::string& entryPath)
+{
+	// Only the header is read, the pixels are checked when the entry is opened
+
+	std::ifstream file(entryPath, std::ios::binary);
+
+	PictureCacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(PictureCacheHeader))) return false;
+	if (header.magic != PICTURE_CACHE_MAGIC || header.version != PICTURE_CACHE_VERSION) return false;
+	if (memchr(header.sourcePath, 0, PICTURE_CACHE_PATH_SIZE) == nullptr) return false;
+
+	uint64_t sourceSize;
+	int64_t sourceModifiedTime;
+
+	return GetSourceInfo(header.sourcePath, &sourceSize, &sourceModifiedTime) &&
+		header.sourceSize == sourceSize && header.sourceModifiedTime == sourceModifiedTime;
+}
+
+void PictureCache::CleanFolder()
+{
+	// Temporary files of a save that didn't finish and entries of pictures
+	// that were removed or changed are never used again
+
+	std::vector<EntryInfo> entries;
+	uint64_t totalBytes = 0;
+	uint32_t removed = 0;
+
+	for (const std::string& name : ListFolder(folderPath))
+	{
+		EntryInfo entry;
+		entry.path = folderPath + name;
+
+		bool isEntry = name.size() > 4 && name.compare(name.size() - 4, 4, ".pic") == 0;
+		bool isTemporary = name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0;
+
+		if (!isEntry && !isTemporary) continue;
+		if (!GetFileInfo(entry.path, &entry.size, &entry.modifiedTime)) continue;
+
+		if (isTemporary || !IsEntryUsable(entry.path))
+		{
+			if (remove(entry.path.c_str()) == 0) removed++;
+			continue;
+		}
+
+		entries.push_back(entry);
+		totalBytes += entry.size;
+	}
+
+	// Then the oldest ones, until the folder fits in the budget
+
+	std::sort(entries.begin(), entries.end(), [](const EntryInfo& a, const EntryInfo& b) { return a.modifiedTime < b.modifiedTime; });
+
+	for (const EntryInfo& entry : entries)
+	{
+		if (totalBytes <= budgetBytes) break;
+		if (remove(entry.path.c_str()) != 0) continue;
+
+		totalBytes -= entry.size;
+		removed++;
+	}
+
+	usedBytes = totalBytes;
+
+	if (removed > 0) LOG_PRINT(LogTypes::Info, "Removed %u files from the picture cache.", removed);
+}
+
+std::vector<std::string> PictureCache::ListFolder(const std::string& path)
+{
+	std::vector<std::string> names;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA((path + "*").c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) return names;
+
+	do
+	{
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(findData.cFileName);
+	}
+	while (FindNextFileA(findHandle, &findData));
+
+	FindClose(findHandle);
+#else
+	DIR* directory = opendir(path.c_str());
+	if (directory == nullptr) return names;
+
+	while (dirent* entry = readdir(directory))
+		if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+
+	closedir(directory);
+#endif
+
+	return names;
+}
+
+bool PictureCache::GetFileInfo(const std::string& path, uint64_t* size, int64_t* modifiedTime)
+{
+#ifdef _WIN32
+	struct _stat64 status;
+	if (_stat64(path.c_str(), &status) != 0) return false;
+#else
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0) return false;
+#endif
+
+	*size = static_cast<uint64_t>(status.st_size);
+	*modifiedTime = static_cast<int64_t>(status.st_mtime);
+
+	return true;
+}
+
+bool PictureCache::CreateFolder(const std::string& path)
+{
+#ifdef _WIN32
+	int result = _mkdir(path.c_str());
+#else
+	int result = mkdir(path.c_str(), 0755);
+#endif
+
+	return result == 0 || errno == EEXIST;
+}
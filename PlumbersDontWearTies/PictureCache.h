@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+#include "MappedFile.h"
+
+// Pictures already decoded and converted to the pixel format of the renderer,
+// kept in a folder of the preferences path. Each entry is a header followed
+// by the rows of the picture, which start at a page so the file can be mapped
+// and given to SDL as it is.
+
+constexpr const char* PICTURE_CACHE_FOLDER_NAME = "PictureCache";
+constexpr uint32_t PICTURE_CACHE_MAGIC = 0x43505044; // "DPPC"
+constexpr uint32_t PICTURE_CACHE_VERSION = 1;
+constexpr size_t PICTURE_CACHE_PATH_SIZE = 256; // including the null terminator
+constexpr size_t PICTURE_CACHE_ALIGNMENT = 4096; // bytes
+constexpr uint64_t PICTURE_CACHE_DEFAULT_BUDGET = 256 * 1024 * 1024; // bytes on disk
+
+#pragma pack(push, 1)
+
+struct PictureCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pixelFormat;
+	int32_t  width;
+	int32_t  height;
+	int32_t  pitch;
+	uint64_t sourceSize;
+	int64_t  sourceModifiedTime; // Seconds since the epoch
+	char     sourcePath[PICTURE_CACHE_PATH_SIZE];
+};
+
+#pragma pack(pop)
+
+// Entries are named after a hash of the path of the source and the pixel
+// format, and are only used while the size and the modification time of the
+// source are the ones they were made from. For pictures in the archive those
+// of the archive are used. The cache is filled as pictures are decoded,
+// until the budget is used up. Initialize removes the entries that can't be
+// used anymore, then the oldest ones until the folder fits in the budget.
+
+class PictureCache
+{
+private:
+	struct EntryInfo
+	{
+		std::string path;
+		uint64_t size;
+		int64_t modifiedTime;
+	};
+
+	static std::string folderPath; // Empty while the cache isn't used
+	static uint64_t budgetBytes;
+	static std::atomic<uint64_t> usedBytes;
+	static std::atomic<uint32_t> hits;
+	static std::atomic<uint32_t> misses;
+	static std::atomic<uint32_t> writes;
+	static std::atomic<uint32_t> temporaryFiles;
+
+public:
+	static bool Initialize();
+	static void Dispose();
+
+	static void SetBudget(const uint64_t bytes);
+
+	// Maps the entry into file and returns a surface that uses its pixels,
+	// so it must be freed before the file is closed
+	static SDL_Surface* Open(const std::string& filePath, const uint32_t pixelFormat, MappedFile* file);
+
+	// Returns a copy of the entry that can outlive it
+	static SDL_Surface* Load(const std::string& filePath, const uint32_t pixelFormat);
+
+	static void Save(const std::string& filePath, const SDL_Surface* surface);
+
+	inline static bool IsInitialized() { return !folderPath.empty(); }
+
+private:
+	static std::string GetEntryPath(const std::string& filePath, const uint32_t pixelFormat);
+	static bool GetSourceInfo(const std::string& filePath, uint64_t* size, int64_t* modifiedTime);
+	static bool IsEntryUsable(const std::string& entryPath);
+	static void CleanFolder();
+	static std::vector<std::string> ListFolder(const std::string& path);
+	static bool GetFileInfo(const std::string& path, uint64_t* size, int64_t* modifiedTime);
+	static bool CreateFolder(const std::string& path);
+};
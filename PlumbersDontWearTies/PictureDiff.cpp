@@ -0,0 +1,91 @@
+#include "PictureDiff.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PICTUREDIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+int64_t PictureDiff::FindDirtyRects(const uint8_t* newPixels, const uint8_t* oldPixels, const int32_t width, const int32_t height, const int32_t pitch, std::vector<SDL_Rect>* dirtyRects)
+{
+	// Compares both 32 bit pictures tile by tile. Consecutive dirty tiles
+	// in the same row of tiles are merged into a single rectangle.
+	// Returns the number of dirty pixels.
+
+	dirtyRects->clear();
+
+	int64_t dirtyPixels = 0;
+
+	for (int32_t tileY = 0; tileY < height; tileY += DIRTY_TILE_SIZE)
+	{
+		int32_t tileH = SDL_min(DIRTY_TILE_SIZE, height - tileY);
+		int32_t runStartX = -1;
+		int32_t numColumns = (width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+
+		// One extra iteration past the last column closes the last run
+
+		for (int32_t column = 0; column <= numColumns; column++)
+		{
+			int32_t tileX = column * DIRTY_TILE_SIZE;
+			bool isDirty = false;
+
+			if (column < numColumns)
+			{
+				int32_t tileW = SDL_min(DIRTY_TILE_SIZE, width - tileX);
+				size_t offset = static_cast<size_t>(tileY) * pitch + static_cast<size_t>(tileX) * 4;
+				isDirty = IsTileDirty(newPixels + offset, oldPixels + offset, tileW * 4, tileH, pitch);
+			}
+
+			if (isDirty)
+			{
+				if (runStartX < 0) runStartX = tileX;
+			}
+			else if (runStartX >= 0)
+			{
+				SDL_Rect rect = { runStartX, tileY, SDL_min(tileX, width) - runStartX, tileH };
+				dirtyRects->push_back(rect);
+				dirtyPixels += static_cast<int64_t>(rect.w) * rect.h;
+				runStartX = -1;
+			}
+		}
+	}
+
+	return dirtyPixels;
+}
+
+bool PictureDiff::IsTileDirty(const uint8_t* newPixels, const uint8_t* oldPixels, const int32_t rowBytes, const int32_t rows, const int32_t pitch)
+{
+	for (int32_t r = 0; r < rows; r++)
+	{
+		if (!AreRowsEqual(newPixels + static_cast<size_t>(r) * pitch, oldPixels + static_cast<size_t>(r) * pitch, rowBytes))
+			return true;
+	}
+
+	return false;
+}
+
+bool PictureDiff::AreRowsEqual(const uint8_t* a, const uint8_t* b, const int32_t bytes)
+{
+	int32_t i = 0;
+
+#ifdef PICTUREDIFF_SSE2
+	for (; i + 64 <= bytes; i += 64)
+	{
+		__m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+		__m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+		__m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 32)));
+		__m128i eq3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 48)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 48)));
+		__m128i eq = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+		if (_mm_movemask_epi8(eq) != 0xFFFF) return false;
+	}
+
+	for (; i + 16 <= bytes; i += 16)
+	{
+		__m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+		if (_mm_movemask_epi8(eq) != 0xFFFF) return false;
+	}
+#endif
+
+	return memcmp(a + i, b + i, bytes - i) == 0;
+}
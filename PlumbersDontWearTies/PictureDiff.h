@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include <SDL.h>
+
+// Size in pixels of the square tiles compared between two pictures
+
+constexpr int32_t DIRTY_TILE_SIZE = 32;
+
+// If more than this fraction of the picture changed, a single full upload is cheaper
+
+constexpr float DIRTY_FULL_UPLOAD_RATIO = 0.75f;
+
+class PictureDiff
+{
+public:
+	static int64_t FindDirtyRects(const uint8_t* newPixels, const uint8_t* oldPixels, const int32_t width, const int32_t height, const int32_t pitch, std::vector<SDL_Rect>* dirtyRects);
+
+private:
+	static bool IsTileDirty(const uint8_t* newPixels, const uint8_t* oldPixels, const int32_t rowBytes, const int32_t rows, const int32_t pitch);
+	static bool AreRowsEqual(const uint8_t* a, const uint8_t* b, const int32_t bytes);
+};
@@ -0,0 +1,274 @@
+#include "PicturePrefetcher.h"
+
+#include <algorithm>
+
+#include "BitmapDecoder.h"
+#include "Log.h"
+#include "PictureCache.h"
+#include "Trace.h"
+
+std::thread PicturePrefetcher::workerThread = std::thread();
+std::mutex PicturePrefetcher::mutex;
+std::condition_variable PicturePrefetcher::workerCondition;
+std::condition_variable PicturePrefetcher::readyCondition;
+bool PicturePrefetcher::isRunning = false;
+uint32_t PicturePrefetcher::pixelFormat = SDL_PIXELFORMAT_ARGB8888;
+
+std::vector<std::string> PicturePrefetcher::wantedPaths = std::vector<std::string>();
+std::deque<std::string> PicturePrefetcher::pendingPaths = std::deque<std::string>();
+std::string PicturePrefetcher::loadingPath = std::string();
+std::map<std::string, SDL_Surface*> PicturePrefetcher::readySurfaces = std::map<std::string, SDL_Surface*>();
+std::deque<std::pair<std::string, SDL_Surface*>> PicturePrefetcher::savingSurfaces = std::deque<std::pair<std::string, SDL_Surface*>>();
+
+uint32_t PicturePrefetcher::hits = 0;
+uint32_t PicturePrefetcher::misses = 0;
+
+bool PicturePrefetcher::Initialize(const uint32_t pixelFormat)
+{
+	if (IsInitialized()) return false;
+
+	PicturePrefetcher::pixelFormat = pixelFormat;
+	isRunning = true;
+	hits = 0;
+	misses = 0;
+
+	workerThread = std::thread(WorkerLoop);
+
+	return true;
+}
+
+void PicturePrefetcher::Dispose()
+{
+	if (!IsInitialized()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isRunning = false;
+		pendingPaths.clear();
+	}
+
+	workerCondition.notify_all();
+	readyCondition.notify_all();
+	workerThread.join();
+
+	for (auto& entry : readySurfaces)
+		SDL_FreeSurface(entry.second);
+
+	readySurfaces.clear();
+	wantedPaths.clear();
+
+	for (auto& entry : savingSurfaces)
+		SDL_FreeSurface(entry.second);
+
+	savingSurfaces.clear();
+
+	LOG_PRINT(LogTypes::Info, "Picture prefetcher stats: %u hits, %u misses.", hits, misses);
+}
+
+void PicturePrefetcher::Prefetch(const std::vector<std::string>& paths)
+{
+	if (!IsInitialized()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		wantedPaths = paths;
+
+		// Drop pictures that are no longer ahead of the cursor
+
+		for (auto it = readySurfaces.begin(); it != readySurfaces.end();)
+		{
+			if (IsWanted(it->first))
+			{
+				++it;
+			}
+			else
+			{
+				SDL_FreeSurface(it->second);
+				it = readySurfaces.erase(it);
+			}
+		}
+
+		// Queue the ones that aren't decoded or being decoded yet, in order
+
+		pendingPaths.clear();
+
+		for (const std::string& path : paths)
+		{
+			if (path == loadingPath) continue;
+			if (readySurfaces.find(path) != readySurfaces.end()) continue;
+			if (std::find(pendingPaths.begin(), pendingPaths.end(), path) != pendingPaths.end()) continue;
+
+			pendingPaths.push_back(path);
+		}
+	}
+
+	workerCondition.notify_one();
+}
+
+SDL_Surface* PicturePrefetcher::Take(const std::string& path)
+{
+	if (!IsInitialized()) return nullptr;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// If the worker is decoding this very picture, waiting for it
+	// is always cheaper than starting the same decode from scratch.
+
+	readyCondition.wait(lock, [&path] { return !isRunning || loadingPath != path; });
+
+	auto it = readySurfaces.find(path);
+	if (it == readySurfaces.end())
+	{
+		auto pending = std::find(pendingPaths.begin(), pendingPaths.end(), path);
+		if (pending != pendingPaths.end()) pendingPaths.erase(pending);
+
+		misses++;
+		return nullptr;
+	}
+
+	SDL_Surface* surface = it->second;
+	readySurfaces.erase(it);
+
+	hits++;
+	return surface;
+}
+
+void PicturePrefetcher::Wait(const std::string& path)
+{
+	// Blocks until the picture is no longer queued nor being decoded,
+	// so the next Take of it doesn't have to wait
+
+	if (!IsInitialized()) return;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	readyCondition.wait(lock, [&path]
+	{
+		return !isRunning || (loadingPath != path && std::find(pendingPaths.begin(), pendingPaths.end(), path) == pendingPaths.end());
+	});
+}
+
+void PicturePrefetcher::Save(const std::string& path, SDL_Surface* surface)
+{
+	if (IsInitialized() && PictureCache::IsInitialized())
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (savingSurfaces.size() < PREFETCH_MAX_SAVES)
+		{
+			savingSurfaces.emplace_back(path, surface);
+			surface = nullptr;
+		}
+	}
+
+	if (surface != nullptr)
+	{
+		SDL_FreeSurface(surface);
+		return;
+	}
+
+	workerCondition.notify_one();
+}
+
+uint32_t PicturePrefetcher::GetHits()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return hits;
+}
+
+uint32_t PicturePrefetcher::GetMisses()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return misses;
+}
+
+void PicturePrefetcher::WorkerLoop()
+{
+	Trace::SetThreadName("Picture prefetcher");
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (isRunning)
+	{
+		workerCondition.wait(lock, [] { return !isRunning || !pendingPaths.empty() || !savingSurfaces.empty(); });
+		if (!isRunning) break;
+
+		// Pictures that will be shown soon come before saving the ones already shown
+
+		if (pendingPaths.empty())
+		{
+			std::pair<std::string, SDL_Surface*> saving = savingSurfaces.front();
+			savingSurfaces.pop_front();
+
+			lock.unlock();
+
+			{
+				TRACE_ZONE("PicturePrefetcher save picture");
+				PictureCache::Save(saving.first, saving.second);
+			}
+
+			SDL_FreeSurface(saving.second);
+			lock.lock();
+
+			continue;
+		}
+
+		loadingPath = pendingPaths.front();
+		pendingPaths.pop_front();
+
+		lock.unlock();
+		SDL_Surface* surface;
+		SDL_Surface* savingSurface = nullptr;
+
+		{
+			TRACE_ZONE("PicturePrefetcher decode BMP");
+
+			// The surface outlives the entry of the picture cache, so it is copied from it
+
+			surface = PictureCache::Load(loadingPath, pixelFormat);
+
+			// A decoded picture is written to the picture cache once nothing is
+			// waiting to be prefetched, from a copy, as the renderer frees its own
+
+			if (surface == nullptr)
+			{
+				surface = BitmapDecoder::Load(loadingPath, pixelFormat);
+
+				if (surface != nullptr && surface->format->format == pixelFormat && PictureCache::IsInitialized())
+					savingSurface = SDL_ConvertSurfaceFormat(surface, pixelFormat, 0);
+			}
+		}
+
+		lock.lock();
+
+		if (savingSurface != nullptr)
+		{
+			if (isRunning && savingSurfaces.size() < PREFETCH_MAX_SAVES)
+				savingSurfaces.emplace_back(loadingPath, savingSurface);
+			else
+				SDL_FreeSurface(savingSurface);
+		}
+
+		if (surface == nullptr)
+		{
+			LOG_PRINT(LogTypes::Warning, "Can't prefetch bitmap %s: %s", loadingPath.c_str(), SDL_GetError());
+		}
+		else if (!isRunning || !IsWanted(loadingPath) || readySurfaces.find(loadingPath) != readySurfaces.end())
+		{
+			SDL_FreeSurface(surface);
+		}
+		else
+		{
+			readySurfaces[loadingPath] = surface;
+		}
+
+		loadingPath.clear();
+		readyCondition.notify_all();
+	}
+}
+
+bool PicturePrefetcher::IsWanted(const std::string& path)
+{
+	return std::find(wantedPaths.begin(), wantedPaths.end(), path) != wantedPaths.end();
+}
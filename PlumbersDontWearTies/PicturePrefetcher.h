@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <SDL.h>
+
+// Number of pictures ahead of the current one that will be decoded in the background
+
+constexpr int32_t PREFETCH_DEPTH = 4;
+
+// Pictures decoded by the renderer waiting to be written to the picture cache, later ones are dropped
+
+constexpr size_t PREFETCH_MAX_SAVES = 2 * PREFETCH_DEPTH;
+
+class PicturePrefetcher
+{
+private:
+	static std::thread workerThread;
+	static std::mutex mutex;
+	static std::condition_variable workerCondition;
+	static std::condition_variable readyCondition;
+	static bool isRunning;
+	static uint32_t pixelFormat;
+
+	static std::vector<std::string> wantedPaths;
+	static std::deque<std::string> pendingPaths;
+	static std::string loadingPath;
+	static std::map<std::string, SDL_Surface*> readySurfaces;
+	static std::deque<std::pair<std::string, SDL_Surface*>> savingSurfaces;
+
+	static uint32_t hits;
+	static uint32_t misses;
+
+public:
+	static bool Initialize(const uint32_t pixelFormat);
+	static void Dispose();
+
+	static void Prefetch(const std::vector<std::string>& paths);
+	static SDL_Surface* Take(const std::string& path);
+	static void Wait(const std::string& path);
+
+	// Writes the picture to the picture cache on the worker thread, and frees it
+	static void Save(const std::string& path, SDL_Surface* surface);
+
+	static uint32_t GetHits();
+	static uint32_t GetMisses();
+
+	inline static bool IsInitialized() { return isRunning; }
+
+private:
+	static void WorkerLoop();
+	static bool IsWanted(const std::string& path);
+};
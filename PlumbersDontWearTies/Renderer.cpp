@@ -1,9 +1,18 @@
 #include "Renderer.h"
 
+#include <algorithm>
+
+#include "BitmapDecoder.h"
 #include "Log.h"
+#include "PictureCache.h"
+#include "PictureDiff.h"
+#include "PicturePrefetcher.h"
+#include "RendererProbe.h"
+#include "Trace.h"
 
 SDL_Window* Renderer::window = nullptr;
 SDL_Renderer* Renderer::renderer = nullptr;
+std::string Renderer::renderDriver = std::string();
 
 int32_t Renderer::rendererWidth = 0;
 int32_t Renderer::rendererHeight = 0;
@@ -13,23 +22,75 @@ float Renderer::viewportScale = 0;
 SDL_Texture* Renderer::currentTexture = nullptr;
 int32_t Renderer::currentTextureWidth = 0;
 int32_t Renderer::currentTextureHeight = 0;
+TextureCache Renderer::textureCache = TextureCache();
+std::mutex Renderer::textureCacheMutex;
+bool Renderer::useStreamingTextures = false;
+std::vector<Renderer::StreamingTexture> Renderer::streamingTextures = std::vector<Renderer::StreamingTexture>();
+uint32_t Renderer::nativeTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+std::vector<uint8_t> Renderer::stagingPixels = std::vector<uint8_t>();
+std::vector<SDL_Rect> Renderer::dirtyRects = std::vector<SDL_Rect>();
+std::vector<uint8_t> Renderer::uploadedPixels = std::vector<uint8_t>();
+int32_t Renderer::uploadedWidth = 0;
+int32_t Renderer::uploadedHeight = 0;
+uint32_t Renderer::uploadCount = 0;
+std::vector<SDL_Rect> Renderer::previousDirtyRects = std::vector<SDL_Rect>();
+int64_t Renderer::previousDirtyPixels = -1;
+
+SoftwareScalingModes Renderer::softwareScalingMode = SoftwareScalingModes::Auto;
+bool Renderer::useSoftwareScaling = false;
+ScalingFilters Renderer::softwareScalingFilter = ScalingFilters::Bilinear;
+SDL_Surface* Renderer::currentSurface = nullptr;
+SDL_Texture* Renderer::scaledTexture = nullptr;
+int32_t Renderer::scaledTextureWidth = 0;
+int32_t Renderer::scaledTextureHeight = 0;
+bool Renderer::isScaledTextureValid = false;
 
 TTF_Font* Renderer::textFont = nullptr;
-SDL_Texture* Renderer::currentTextTexture = nullptr;
-int32_t Renderer::currentTextTextureWidth = 0;
-int32_t Renderer::currentTextTextureHeight = 0;
+SDL_Texture* Renderer::glyphAtlas = nullptr;
+Renderer::Glyph Renderer::glyphs[GLYPH_ATLAS_LAST - GLYPH_ATLAS_FIRST + 1];
+int32_t Renderer::glyphHeight = 0;
+int32_t Renderer::glyphLineSkip = 0;
+
+std::string Renderer::scoreText = std::string();
+int32_t Renderer::scoreTextWidth = 0;
+int32_t Renderer::scoreTextHeight = 0;
+
+std::string Renderer::overlayText = std::string();
+int32_t Renderer::overlayTextWidth = 0;
+int32_t Renderer::overlayTextHeight = 0;
+
+std::string Renderer::framePictureFileName = std::string();
+std::string Renderer::frameScoreText = std::string();
 
 bool Renderer::Initialize(SDL_Window* window, const std::string fontPath)
 {
 	if (IsInitialized()) return false;
 
-	// Initialize SDL renderer
+	// Initialize SDL renderer, with the fastest driver unless one has been chosen
+	// with --render-driver or the SDL_RENDER_DRIVER environment variable
+
+	std::string driverName = renderDriver;
+	if (driverName.empty() && SDL_GetHint(SDL_HINT_RENDER_DRIVER) == nullptr) driverName = RendererProbe::SelectDriver(window);
+	if (!driverName.empty()) SDL_SetHint(SDL_HINT_RENDER_DRIVER, driverName.c_str());
+
+	const char* driverHint = SDL_GetHint(SDL_HINT_RENDER_DRIVER);
+	bool isSoftwareChosen = driverHint != nullptr && SDL_strcasecmp(driverHint, "software") == 0;
+
+	// The software renderer can't be created with the accelerated flag
+
+	if (!isSoftwareChosen) renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 
-	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengles2");
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 	if (renderer == nullptr)
 	{
-		Log::Print(LogTypes::Critical, "Could not create a renderer: %s", SDL_GetError());
+		// Video drivers without acceleration, like the dummy one, still have the software renderer
+
+		if (!isSoftwareChosen) LOG_PRINT(LogTypes::Warning, "Could not create an accelerated renderer, using the software one: %s", SDL_GetError());
+		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+	}
+
+	if (renderer == nullptr)
+	{
+		LOG_PRINT(LogTypes::Critical, "Could not create a renderer: %s", SDL_GetError());
 		return false;
 	}
 
@@ -39,11 +100,39 @@ bool Renderer::Initialize(SDL_Window* window, const std::string fontPath)
 	if (SDL_GetRendererOutputSize(renderer, &rw, &rh) < 0)
 	{
 		Dispose();
-		Log::Print(LogTypes::Critical, "Could not get renderer output size: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Critical, "Could not get renderer output size: %s", SDL_GetError());
 		return false;
 	}
 
-	Log::Print(LogTypes::Info, "Renderer initialized: resolution %ix%i.", rw, rh);
+	// Find out the preferred texture format, so pictures can be converted only once
+
+	bool isSoftwareRenderer = false;
+	const char* rendererName = "unknown";
+
+	SDL_RendererInfo rendererInfo;
+	if (SDL_GetRendererInfo(renderer, &rendererInfo) == 0)
+	{
+		isSoftwareRenderer = (rendererInfo.flags & SDL_RENDERER_SOFTWARE) != 0;
+		rendererName = rendererInfo.name;
+
+		for (uint32_t f = 0; f < rendererInfo.num_texture_formats; f++)
+		{
+			uint32_t format = rendererInfo.texture_formats[f];
+			if (SDL_ISPIXELFORMAT_FOURCC(format) || SDL_ISPIXELFORMAT_INDEXED(format) || SDL_BYTESPERPIXEL(format) != 4) continue;
+
+			nativeTextureFormat = format;
+			break;
+		}
+	}
+
+	// Without a GPU, stretching the picture on every frame is the slowest part of a frame
+
+	useSoftwareScaling = softwareScalingMode == SoftwareScalingModes::Nearest || softwareScalingMode == SoftwareScalingModes::Bilinear ||
+		(softwareScalingMode == SoftwareScalingModes::Auto && isSoftwareRenderer);
+	softwareScalingFilter = softwareScalingMode == SoftwareScalingModes::Nearest ? ScalingFilters::Nearest : ScalingFilters::Bilinear;
+
+	LOG_PRINT(LogTypes::Info, "Renderer initialized: driver %s, resolution %ix%i, texture format %s, software scaling %s.", rendererName, rw, rh, SDL_GetPixelFormatName(nativeTextureFormat),
+		!useSoftwareScaling ? "off" : softwareScalingFilter == ScalingFilters::Nearest ? "nearest" : "bilinear");
 
 	WindowSizeChanged(rw, rh);
 
@@ -51,13 +140,17 @@ bool Renderer::Initialize(SDL_Window* window, const std::string fontPath)
 
 	if (TTF_Init() < 0)
 	{
-		Log::Print(LogTypes::Error, "TTF has not been initialized: %s", TTF_GetError());
+		LOG_PRINT(LogTypes::Error, "TTF has not been initialized: %s", TTF_GetError());
 	}
 
-	textFont = TTF_OpenFont(fontPath.c_str(), 48);
+	textFont = TTF_OpenFont(fontPath.c_str(), TEXT_FONT_SIZE);
 	if (textFont == nullptr)
 	{
-		Log::Print(LogTypes::Error, "%s has not been found or couldn't be opened: %s", fontPath.c_str(), TTF_GetError());
+		LOG_PRINT(LogTypes::Error, "%s has not been found or couldn't be opened: %s", fontPath.c_str(), TTF_GetError());
+	}
+	else
+	{
+		BuildGlyphAtlas();
 	}
 
 	return true;
@@ -76,18 +169,53 @@ void Renderer::Dispose()
 		TTF_Quit();
 	}
 
-	if (currentTexture != nullptr)
+	const TextureCacheStats& cacheStats = textureCache.GetStats();
+	LOG_PRINT(LogTypes::Info, "Texture cache stats: %u hits, %u misses, %u evictions, %u entries using %u KB.", cacheStats.hits, cacheStats.misses, cacheStats.evictions, cacheStats.entries, static_cast<uint32_t>(cacheStats.usedBytes / 1024));
+
+	{
+		std::lock_guard<std::mutex> lock(textureCacheMutex);
+		textureCache.Clear();
+	}
+
+	currentTexture = nullptr;
+	framePictureFileName.clear();
+	frameScoreText.clear();
+
+	for (StreamingTexture& streamingTexture : streamingTextures)
+		SDL_DestroyTexture(streamingTexture.texture);
+
+	streamingTextures.clear();
+	stagingPixels.clear();
+	uploadedPixels.clear();
+	uploadedWidth = 0;
+	uploadedHeight = 0;
+	uploadCount = 0;
+	previousDirtyRects.clear();
+	previousDirtyPixels = -1;
+
+	if (currentSurface != nullptr)
 	{
-		SDL_DestroyTexture(currentTexture);
-		currentTexture = nullptr;
+		SDL_FreeSurface(currentSurface);
+		currentSurface = nullptr;
 	}
 
-	if (currentTextTexture != nullptr)
+	if (scaledTexture != nullptr)
 	{
-		SDL_DestroyTexture(currentTextTexture);
-		currentTextTexture = nullptr;
+		SDL_DestroyTexture(scaledTexture);
+		scaledTexture = nullptr;
 	}
 
+	isScaledTextureValid = false;
+
+	if (glyphAtlas != nullptr)
+	{
+		SDL_DestroyTexture(glyphAtlas);
+		glyphAtlas = nullptr;
+	}
+
+	scoreText.clear();
+	overlayText.clear();
+
 	if (renderer != nullptr)
 	{
 		SDL_DestroyRenderer(renderer);
@@ -95,6 +223,37 @@ void Renderer::Dispose()
 	}
 }
 
+void Renderer::SetFrame(const std::string baseDataPath, const FrameSnapshot& frame)
+{
+	// Only what changed since the previous frame is loaded again
+
+	if (frame.pictureFileName != framePictureFileName)
+	{
+		framePictureFileName = frame.pictureFileName;
+		if (!framePictureFileName.empty()) LoadPictureFromBMP(baseDataPath, framePictureFileName);
+	}
+
+	if (frame.scoreText != frameScoreText)
+	{
+		frameScoreText = frame.scoreText;
+		GenerateScoreText(frameScoreText);
+	}
+}
+
+void Renderer::RenderFrame(const FrameSnapshot& frame)
+{
+	if (!IsInitialized()) return;
+
+	Clear(0, 0, 0);
+	RenderPicture();
+
+	if (frame.isWaitingDecision)
+	{
+		if (frame.hasSelection) RenderDecisionSelection(frame.selectionX, frame.selectionY, frame.selectionW, frame.selectionH);
+		RenderScore();
+	}
+}
+
 void Renderer::Clear(const uint8_t r, const uint8_t g, const uint8_t b)
 {
 	if (!IsInitialized()) return;
@@ -108,6 +267,15 @@ void Renderer::RenderPicture()
 	if (!IsInitialized()) return;
 
 	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+	// The software scaled picture has the size of the viewport, so it's a plain copy
+
+	if (useSoftwareScaling)
+	{
+		if (isScaledTextureValid || UpdateScaledTexture()) SDL_RenderCopy(renderer, scaledTexture, NULL, NULL);
+		return;
+	}
+
 	SDL_RenderCopy(renderer, currentTexture, NULL, NULL);
 }
 
@@ -134,16 +302,41 @@ void Renderer::RenderScore()
 
 	SDL_Rect textRect;
 	textRect.x = 32;
-	textRect.y = static_cast<int32_t>(viewportRect.h / textScale) - 32 - currentTextTextureHeight;
-	textRect.w = currentTextTextureWidth;
-	textRect.h = currentTextTextureHeight;
+	textRect.y = static_cast<int32_t>(viewportRect.h / textScale) - 32 - scoreTextHeight;
+	textRect.w = scoreTextWidth;
+	textRect.h = scoreTextHeight;
 	ScaleRect(&textRect, textScale);
 
-	SDL_RenderCopy(renderer, currentTextTexture, NULL, &textRect);
+	RenderText(scoreText, textRect.x, textRect.y, textScale);
+}
+
+void Renderer::RenderOverlay()
+{
+	if (!IsInitialized() || overlayText.empty()) return;
+
+	// Top left corner of the window, over a dark box so it can be read on any picture
+
+	SDL_Rect textRect;
+	textRect.x = 16;
+	textRect.y = 16;
+	textRect.w = static_cast<int32_t>(overlayTextWidth * OVERLAY_TEXT_SCALE);
+	textRect.h = static_cast<int32_t>(overlayTextHeight * OVERLAY_TEXT_SCALE);
+
+	SDL_Rect backgroundRect = { textRect.x - 8, textRect.y - 8, textRect.w + 16, textRect.h + 16 };
+
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 192);
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_RenderFillRect(renderer, &backgroundRect);
+
+	RenderText(overlayText, textRect.x, textRect.y, OVERLAY_TEXT_SCALE);
 }
 
 void Renderer::Present()
 {
+	if (!IsInitialized()) return;
+
+	TRACE_ZONE("Renderer::Present");
+
 	SDL_RenderPresent(renderer);
 }
 
@@ -155,34 +348,123 @@ void Renderer::WindowSizeChanged(const int32_t width, const int32_t height)
 	rendererHeight = height;
 
 	UpdateViewport();
-	Log::Print(LogTypes::Info, "New window size: %ix%i.", width, height);
+	LOG_PRINT(LogTypes::Info, "New window size: %ix%i.", width, height);
 }
 
 bool Renderer::LoadPictureFromBMP(const std::string baseDataPath, std::string fileName)
 {
 	if (!IsInitialized()) return false;
 
-	if (currentTexture != nullptr)
+	TRACE_ZONE("Renderer::LoadPictureFromBMP");
+
+	Uint64 startTime = SDL_GetPerformanceCounter();
+
+	SDL_Texture* previousTexture = currentTexture;
+	currentTexture = nullptr;
+
+	// Pictures that have been shown recently are still in the cache
+
+	std::string filePath = baseDataPath + fileName;
+
+	if (!useStreamingTextures && !useSoftwareScaling)
 	{
-		SDL_DestroyTexture(currentTexture);
-		currentTexture = nullptr;
+		int32_t cachedWidth, cachedHeight;
+		SDL_Texture* cachedTexture;
+
+		{
+			std::lock_guard<std::mutex> lock(textureCacheMutex);
+			cachedTexture = textureCache.Get(filePath, &cachedWidth, &cachedHeight);
+		}
+
+		if (cachedTexture != nullptr)
+		{
+			currentTextureWidth = cachedWidth;
+			currentTextureHeight = cachedHeight;
+			currentTexture = cachedTexture;
+
+			UpdateViewport();
+
+			LOG_PRINT(LogTypes::Info, "Loaded picture %s (%ix%i) from cache in %.2f ms", fileName.c_str(), currentTextureWidth, currentTextureHeight, GetElapsedMilliseconds(startTime));
+
+			return true;
+		}
 	}
 
-	SDL_Surface* newSurface = SDL_LoadBMP((baseDataPath + fileName).c_str());
+	// Use the picture decoded in advance by the prefetcher if available,
+	// then the one mapped from the picture cache, which is uploaded from
+	// the mapping, and otherwise decode it synchronously.
+
+	MappedFile cachedFile;
+	SDL_Surface* newSurface;
+	bool isDecoded = false;
+
+	{
+		TRACE_ZONE("Renderer decode BMP");
+
+		newSurface = PicturePrefetcher::Take(filePath);
+		if (newSurface == nullptr) newSurface = PictureCache::Open(filePath, nativeTextureFormat, &cachedFile);
+
+		if (newSurface == nullptr)
+		{
+			newSurface = BitmapDecoder::Load(filePath, nativeTextureFormat);
+			isDecoded = true;
+		}
+	}
 
 	if (newSurface == nullptr)
 	{
-		Log::Print(LogTypes::Error, "Can't load bitmap: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Error, "Can't load bitmap: %s", SDL_GetError());
 		return false;
 	}
 
+	if (useSoftwareScaling)
+	{
+		// Only pictures that SDL loaded itself aren't in the native format yet,
+		// and the ones of the picture cache are copied out of its mapping
+
+		if (newSurface->format->format != nativeTextureFormat || cachedFile.IsOpen())
+		{
+			SDL_Surface* convertedSurface = SDL_ConvertSurfaceFormat(newSurface, nativeTextureFormat, 0);
+			SDL_FreeSurface(newSurface);
+			newSurface = convertedSurface;
+
+			if (newSurface == nullptr)
+			{
+				LOG_PRINT(LogTypes::Error, "Can't convert bitmap: %s", SDL_GetError());
+				return false;
+			}
+		}
+
+		if (currentSurface != nullptr) SDL_FreeSurface(currentSurface);
+
+		currentSurface = newSurface;
+		currentTextureWidth = newSurface->w;
+		currentTextureHeight = newSurface->h;
+
+		UpdateViewport();
+
+		LOG_PRINT(LogTypes::Info, "Loaded picture %s (%ix%i) in %.2f ms", fileName.c_str(), currentTextureWidth, currentTextureHeight, GetElapsedMilliseconds(startTime));
+
+		return true;
+	}
+
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_Texture* newTexture = SDL_CreateTextureFromSurface(renderer, newSurface);
+
+	SDL_Texture* newTexture;
+
+	{
+		TRACE_ZONE("Renderer upload texture");
+
+		if (useStreamingTextures)
+			newTexture = UploadToStreamingTexture(newSurface, previousTexture);
+		else
+			newTexture = SDL_CreateTextureFromSurface(renderer, newSurface);
+	}
 
 	if (newTexture == nullptr)
 	{
 		SDL_FreeSurface(newSurface);
-		Log::Print(LogTypes::Error, "Can't create texture: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Error, "Can't create texture: %s", SDL_GetError());
 		return false;
 	}
 
@@ -190,74 +472,445 @@ bool Renderer::LoadPictureFromBMP(const std::string baseDataPath, std::string fi
 	currentTextureHeight = newSurface->h;
 	currentTexture = newTexture;
 
-	SDL_FreeSurface(newSurface);
+	if (!useStreamingTextures)
+	{
+		std::lock_guard<std::mutex> lock(textureCacheMutex);
+		textureCache.Add(filePath, newTexture, currentTextureWidth, currentTextureHeight);
+	}
+
+	// The prefetcher writes what was decoded here to the picture cache, off this thread
+
+	if (isDecoded && newSurface->format->format == nativeTextureFormat)
+		PicturePrefetcher::Save(filePath, newSurface);
+	else
+		SDL_FreeSurface(newSurface);
 
 	UpdateViewport();
 
-	Log::Print(LogTypes::Info, "Loaded picture %s (%ix%i)", fileName.c_str(), currentTextureWidth, currentTextureHeight);
+	LOG_PRINT(LogTypes::Info, "Loaded picture %s (%ix%i) in %.2f ms", fileName.c_str(), currentTextureWidth, currentTextureHeight, GetElapsedMilliseconds(startTime));
 
 	return true;
 }
 
+void Renderer::SetStreamingTextures(const bool enabled)
+{
+	useStreamingTextures = enabled;
+	LOG_PRINT(LogTypes::Info, "Streaming textures %s.", enabled ? "enabled" : "disabled");
+}
+
+void Renderer::SetRenderDriver(const std::string& driverName)
+{
+	renderDriver = driverName;
+}
+
+void Renderer::SetSoftwareScaling(const SoftwareScalingModes mode)
+{
+	softwareScalingMode = mode;
+}
+
+void Renderer::SetTextureCacheBudget(const size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(textureCacheMutex);
+		textureCache.SetBudget(bytes);
+	}
+
+	LOG_PRINT(LogTypes::Info, "Texture cache budget set to %u KB.", static_cast<uint32_t>(bytes / 1024));
+}
+
+bool Renderer::IsPictureCached(const std::string& filePath)
+{
+	std::lock_guard<std::mutex> lock(textureCacheMutex);
+	return textureCache.Contains(filePath);
+}
+
 bool Renderer::GenerateScoreText(const std::string text)
 {
 	if (!IsInitialized()) return false;
 
-	if (currentTextTexture != nullptr)
+	// Drawn from the glyph atlas, so changing it only measures it
+
+	scoreText = text;
+	MeasureText(scoreText, &scoreTextWidth, &scoreTextHeight);
+
+	if (!text.empty() && glyphAtlas == nullptr)
 	{
-		SDL_DestroyTexture(currentTextTexture);
-		currentTextTexture = nullptr;
-		currentTextTextureWidth = 0;
-		currentTextTextureHeight = 0;
+		LOG_PRINT(LogTypes::Info, "%s", text.c_str());
+		return false;
 	}
 
-	if (text.empty())
+	return true;
+}
+
+bool Renderer::SetOverlayText(const std::string& text)
+{
+	if (!IsInitialized()) return false;
+
+	overlayText = text;
+	MeasureText(overlayText, &overlayTextWidth, &overlayTextHeight);
+
+	return text.empty() || glyphAtlas != nullptr;
+}
+
+bool Renderer::BuildGlyphAtlas()
+{
+	// Rasterize every character on its own, then pack them in rows
+
+	std::vector<SDL_Surface*> glyphSurfaces;
+	SDL_Color white = { 255, 255, 255, 255 };
+	int32_t x = 0, y = 0, rowHeight = 0;
+
+	for (char c = GLYPH_ATLAS_FIRST; c <= GLYPH_ATLAS_LAST; c++)
 	{
-		return true;
+		char text[2] = { c, '\0' };
+		Glyph* glyph = &glyphs[c - GLYPH_ATLAS_FIRST];
+
+		int minX, maxX, minY, maxY, advance;
+		if (TTF_GlyphMetrics(textFont, static_cast<Uint16>(c), &minX, &maxX, &minY, &maxY, &advance) < 0) advance = 0;
+
+		// Spaces have nothing to draw, only their advance
+
+		SDL_Surface* glyphSurface = c == ' ' ? nullptr : TTF_RenderText_Blended(textFont, text, white);
+		glyphSurfaces.push_back(glyphSurface);
+
+		glyph->advance = advance;
+		glyph->atlasRect = { 0, 0, 0, 0 };
+
+		if (glyphSurface == nullptr) continue;
+
+		if (x + glyphSurface->w > GLYPH_ATLAS_WIDTH)
+		{
+			x = 0;
+			y += rowHeight + GLYPH_ATLAS_PADDING;
+			rowHeight = 0;
+		}
+
+		glyph->atlasRect = { x, y, glyphSurface->w, glyphSurface->h };
+
+		x += glyphSurface->w + GLYPH_ATLAS_PADDING;
+		rowHeight = std::max(rowHeight, glyphSurface->h);
 	}
 
-	const char* cText = text.c_str();
+	SDL_Surface* atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_WIDTH, y + rowHeight, 32, SDL_PIXELFORMAT_ARGB8888);
 
-	if (textFont == nullptr)
+	if (atlasSurface != nullptr)
 	{
-		Log::Print(LogTypes::Info, "%s", cText);
-		return false;
+		SDL_FillRect(atlasSurface, NULL, 0);
+
+		for (size_t g = 0; g < glyphSurfaces.size(); g++)
+		{
+			if (glyphSurfaces[g] == nullptr) continue;
+
+			// Copy the alpha of the glyph instead of blending it over the empty atlas
+			SDL_SetSurfaceBlendMode(glyphSurfaces[g], SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(glyphSurfaces[g], NULL, atlasSurface, &glyphs[g].atlasRect);
+		}
+
+		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+		glyphAtlas = SDL_CreateTextureFromSurface(renderer, atlasSurface);
+		SDL_FreeSurface(atlasSurface);
 	}
 
-	SDL_Color white = { 255, 255, 255, 255 };
-	SDL_Surface* textSurface = TTF_RenderText_Blended(textFont, cText, white);
+	for (SDL_Surface* glyphSurface : glyphSurfaces)
+		SDL_FreeSurface(glyphSurface);
 
-	if (textSurface == nullptr)
+	if (glyphAtlas == nullptr)
 	{
-		Log::Print(LogTypes::Error, "Can't create text surface: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Error, "Can't create the glyph atlas: %s", SDL_GetError());
 		return false;
 	}
 
-	SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
+	SDL_SetTextureBlendMode(glyphAtlas, SDL_BLENDMODE_BLEND);
+
+	glyphHeight = TTF_FontHeight(textFont);
+	glyphLineSkip = TTF_FontLineSkip(textFont);
+
+	LOG_PRINT(LogTypes::Info, "Glyph atlas created: %ix%i.", GLYPH_ATLAS_WIDTH, y + rowHeight);
+
+	return true;
+}
+
+const Renderer::Glyph& Renderer::GetGlyph(const char character)
+{
+	if (character < GLYPH_ATLAS_FIRST || character > GLYPH_ATLAS_LAST) return glyphs['?' - GLYPH_ATLAS_FIRST];
+
+	return glyphs[character - GLYPH_ATLAS_FIRST];
+}
+
+int32_t Renderer::GetKerning(const char previous, const char character)
+{
+	// Between the characters that are drawn, so '?' for the ones not in the atlas
+
+	if (previous == '\0') return 0;
 
-	SDL_FreeSurface(textSurface);
+	Uint16 previousGlyph = previous < GLYPH_ATLAS_FIRST || previous > GLYPH_ATLAS_LAST ? '?' : previous;
+	Uint16 glyph = character < GLYPH_ATLAS_FIRST || character > GLYPH_ATLAS_LAST ? '?' : character;
+
+	return TTF_GetFontKerningSizeGlyphs(textFont, previousGlyph, glyph);
+}
 
-	if (textTexture == nullptr)
+void Renderer::MeasureText(const std::string& text, int32_t* width, int32_t* height)
+{
+	*width = 0;
+	*height = 0;
+
+	if (text.empty() || glyphAtlas == nullptr) return;
+
+	int32_t lineWidth = 0;
+	char previous = '\0';
+	*height = glyphHeight;
+
+	for (char c : text)
 	{
-		Log::Print(LogTypes::Error, "Can't create text texture: %s", SDL_GetError());
-		return false;
+		if (c == '\n')
+		{
+			lineWidth = 0;
+			previous = '\0';
+			*height += glyphLineSkip;
+			continue;
+		}
+
+		lineWidth += GetKerning(previous, c) + GetGlyph(c).advance;
+		previous = c;
+		*width = std::max(*width, lineWidth);
+	}
+}
+
+void Renderer::RenderText(const std::string& text, const int32_t x, const int32_t y, const float scale)
+{
+	if (glyphAtlas == nullptr) return;
+
+	// One copy per glyph from the same texture, which SDL batches into a single draw
+
+	float penX = 0.0f, penY = 0.0f;
+	char previous = '\0';
+
+	for (char c : text)
+	{
+		if (c == '\n')
+		{
+			penX = 0.0f;
+			previous = '\0';
+			penY += glyphLineSkip;
+			continue;
+		}
+
+		const Glyph& glyph = GetGlyph(c);
+		penX += GetKerning(previous, c);
+		previous = c;
+
+		if (glyph.atlasRect.w > 0)
+		{
+			SDL_Rect glyphRect;
+			glyphRect.x = x + static_cast<int32_t>(penX * scale);
+			glyphRect.y = y + static_cast<int32_t>(penY * scale);
+			glyphRect.w = static_cast<int32_t>(glyph.atlasRect.w * scale);
+			glyphRect.h = static_cast<int32_t>(glyph.atlasRect.h * scale);
+
+			SDL_RenderCopy(renderer, glyphAtlas, &glyph.atlasRect, &glyphRect);
+		}
+
+		penX += glyph.advance;
+	}
+}
+
+bool Renderer::UpdateScaledTexture()
+{
+	if (currentSurface == nullptr || viewportRect.w <= 0 || viewportRect.h <= 0) return false;
+
+	TRACE_ZONE("Renderer software scaling");
+
+	Uint64 startTime = SDL_GetPerformanceCounter();
+
+	if (scaledTexture == nullptr || scaledTextureWidth != viewportRect.w || scaledTextureHeight != viewportRect.h)
+	{
+		if (scaledTexture != nullptr) SDL_DestroyTexture(scaledTexture);
+
+		scaledTexture = SDL_CreateTexture(renderer, nativeTextureFormat, SDL_TEXTUREACCESS_STREAMING, viewportRect.w, viewportRect.h);
+
+		if (scaledTexture == nullptr)
+		{
+			scaledTextureWidth = 0;
+			scaledTextureHeight = 0;
+			LOG_PRINT(LogTypes::Error, "Can't create the scaled texture: %s", SDL_GetError());
+			return false;
+		}
+
+		SDL_SetTextureBlendMode(scaledTexture, SDL_BLENDMODE_NONE);
+		scaledTextureWidth = viewportRect.w;
+		scaledTextureHeight = viewportRect.h;
 	}
 
-	int32_t w, h;
-	if (TTF_SizeText(textFont, cText, &w, &h) < 0)
+	void* pixels;
+	int pitch;
+
+	if (SDL_LockTexture(scaledTexture, NULL, &pixels, &pitch) < 0)
 	{
-		SDL_DestroyTexture(textTexture);
-		Log::Print(LogTypes::Error, "Can't calculate size of text texture: %s", TTF_GetError());
+		LOG_PRINT(LogTypes::Error, "Can't lock the scaled texture: %s", SDL_GetError());
 		return false;
 	}
 
-	currentTextTexture = textTexture;
-	currentTextTextureWidth = w;
-	currentTextTextureHeight = h;
+	SoftwareScaler::Scale(currentSurface, static_cast<uint8_t*>(pixels), scaledTextureWidth, scaledTextureHeight, pitch, softwareScalingFilter);
+	SDL_UnlockTexture(scaledTexture);
+
+	isScaledTextureValid = true;
+
+	LOG_PRINT(LogTypes::Info, "Scaled picture to %ix%i in %.2f ms", scaledTextureWidth, scaledTextureHeight, GetElapsedMilliseconds(startTime));
+
+	return true;
+}
+
+SDL_Texture* Renderer::UploadToStreamingTexture(SDL_Surface* surface, SDL_Texture* textureInUse)
+{
+	// Find a texture of the same size that is not the one on screen,
+	// so the driver doesn't have to wait for it to be released.
+
+	StreamingTexture* target = nullptr;
+	int32_t sameSizeCount = 0;
+
+	for (StreamingTexture& streamingTexture : streamingTextures)
+	{
+		if (streamingTexture.width != surface->w || streamingTexture.height != surface->h) continue;
+
+		sameSizeCount++;
+		if (streamingTexture.texture != textureInUse)
+		{
+			target = &streamingTexture;
+			break;
+		}
+	}
+
+	if (target == nullptr)
+	{
+		if (sameSizeCount >= STREAMING_TEXTURES_PER_SIZE)
+		{
+			// Only possible if there is a single texture per size
+
+			for (StreamingTexture& streamingTexture : streamingTextures)
+			{
+				if (streamingTexture.width == surface->w && streamingTexture.height == surface->h)
+				{
+					target = &streamingTexture;
+					break;
+				}
+			}
+		}
+		else
+		{
+			StreamingTexture newStreamingTexture;
+			newStreamingTexture.texture = SDL_CreateTexture(renderer, nativeTextureFormat, SDL_TEXTUREACCESS_STREAMING, surface->w, surface->h);
+			newStreamingTexture.width = surface->w;
+			newStreamingTexture.height = surface->h;
+			newStreamingTexture.uploadIndex = 0;
+
+			if (newStreamingTexture.texture == nullptr) return nullptr;
+
+			streamingTextures.push_back(newStreamingTexture);
+			target = &streamingTextures.back();
+
+			LOG_PRINT(LogTypes::Info, "Created streaming texture %ix%i (%s).", surface->w, surface->h, SDL_GetPixelFormatName(nativeTextureFormat));
+		}
+	}
+
+	// Convert the new picture to the texture format
+
+	int32_t pitch = surface->w * 4;
+	stagingPixels.resize(static_cast<size_t>(pitch) * surface->h);
+	if (!ConvertSurfacePixels(surface, stagingPixels.data(), pitch)) return nullptr;
+
+	// Consecutive pictures usually come from the same shot, so compare the
+	// new picture with the last one uploaded and upload only the tiles that
+	// changed. The target is usually one picture behind that one, as the last
+	// picture went to the texture on screen, so the tiles that changed from
+	// the picture before are uploaded too.
+
+	int64_t totalBytes = static_cast<int64_t>(stagingPixels.size());
+	int64_t uploadedBytes = totalBytes;
+	int64_t dirtyPixels = -1;
+
+	if (uploadedWidth == surface->w && uploadedHeight == surface->h && uploadedPixels.size() == stagingPixels.size())
+		dirtyPixels = PictureDiff::FindDirtyRects(stagingPixels.data(), uploadedPixels.data(), surface->w, surface->h, pitch, &dirtyRects);
+
+	bool isTargetBehind = target->uploadIndex != uploadCount;
+	int64_t patchPixels = -1;
+
+	if (dirtyPixels >= 0 && target->uploadIndex != 0)
+	{
+		if (!isTargetBehind)
+			patchPixels = dirtyPixels;
+		else if (target->uploadIndex == uploadCount - 1 && previousDirtyPixels >= 0)
+			patchPixels = dirtyPixels + previousDirtyPixels;
+	}
+
+	if (patchPixels >= 0 && patchPixels < static_cast<int64_t>(surface->w * surface->h * DIRTY_FULL_UPLOAD_RATIO))
+	{
+		if (!UploadDirtyRects(target->texture, dirtyRects, pitch) || (isTargetBehind && !UploadDirtyRects(target->texture, previousDirtyRects, pitch)))
+		{
+			target->uploadIndex = 0;
+			return nullptr;
+		}
+
+		uploadedBytes = patchPixels * 4;
+	}
+	else
+	{
+		if (SDL_UpdateTexture(target->texture, NULL, stagingPixels.data(), pitch) < 0)
+		{
+			target->uploadIndex = 0;
+			return nullptr;
+		}
+	}
+
+	LOG_PRINT(LogTypes::Info, "Uploaded %lli of %lli bytes (%lli bytes saved).", static_cast<long long>(uploadedBytes), static_cast<long long>(totalBytes), static_cast<long long>(totalBytes - uploadedBytes));
+
+	// Keep the new picture and what changed for the next uploads, reusing the old buffers
+
+	uploadedPixels.swap(stagingPixels);
+	uploadedWidth = surface->w;
+	uploadedHeight = surface->h;
+	previousDirtyRects.swap(dirtyRects);
+	previousDirtyPixels = dirtyPixels;
+
+	target->uploadIndex = ++uploadCount;
+
+	return target->texture;
+}
+
+bool Renderer::UploadDirtyRects(SDL_Texture* texture, const std::vector<SDL_Rect>& rects, const int32_t pitch)
+{
+	// The rectangles are taken from the new picture, in the staging buffer
+
+	for (const SDL_Rect& rect : rects)
+	{
+		const uint8_t* rectPixels = stagingPixels.data() + static_cast<size_t>(rect.y) * pitch + static_cast<size_t>(rect.x) * 4;
+		if (SDL_UpdateTexture(texture, &rect, rectPixels, pitch) < 0) return false;
+	}
 
 	return true;
 }
 
+bool Renderer::ConvertSurfacePixels(SDL_Surface* surface, uint8_t* pixels, const int32_t pitch)
+{
+	if (SDL_ISPIXELFORMAT_INDEXED(surface->format->format))
+	{
+		// SDL_ConvertPixels doesn't support palettes, a blit does
+
+		SDL_Surface* targetSurface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, surface->w, surface->h, 32, pitch, nativeTextureFormat);
+		if (targetSurface == nullptr) return false;
+
+		int32_t result = SDL_BlitSurface(surface, NULL, targetSurface, NULL);
+		SDL_FreeSurface(targetSurface);
+		return result == 0;
+	}
+
+	return SDL_ConvertPixels(surface->w, surface->h, surface->format->format, surface->pixels, surface->pitch, nativeTextureFormat, pixels, pitch) == 0;
+}
+
+double Renderer::GetElapsedMilliseconds(const Uint64 startTime)
+{
+	return (SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
 void Renderer::UpdateViewport()
 {
 	float rendererAspectRatio = static_cast<float>(rendererWidth) / rendererHeight;
@@ -285,6 +938,7 @@ void Renderer::UpdateViewport()
 	}
 
 	SDL_RenderSetViewport(renderer, &viewportRect);
+	isScaledTextureValid = false;
 }
 
 void Renderer::ScaleRect(SDL_Rect* rectToScale, const float scale)
@@ -1,15 +1,67 @@
 #pragma once
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <SDL.h>
 #include <SDL_ttf.h>
 
+#include "FrameSnapshot.h"
+#include "SoftwareScaler.h"
+#include "TextureCache.h"
+
+// Number of streaming textures kept for each picture size, so a new picture
+// can be written while the previous one may still be in use by the driver.
+
+constexpr int32_t STREAMING_TEXTURES_PER_SIZE = 2;
+
+enum class SoftwareScalingModes
+{
+	Auto, // Only with the software renderer
+	Off,
+	Nearest,
+	Bilinear
+};
+
+// Text is drawn from an atlas of the printable ASCII characters, rasterized
+// once at the size of the score. Other characters are drawn as '?'. The
+// kerning of the font is applied between consecutive glyphs.
+
+constexpr int32_t TEXT_FONT_SIZE = 48; // points
+constexpr char GLYPH_ATLAS_FIRST = ' ';
+constexpr char GLYPH_ATLAS_LAST = '~';
+constexpr int32_t GLYPH_ATLAS_WIDTH = 1024; // pixels, glyphs are packed in rows
+constexpr int32_t GLYPH_ATLAS_PADDING = 2; // pixels, so filtering doesn't bleed into the next glyph
+
+// The overlay uses the font of the score, but smaller
+
+constexpr float OVERLAY_TEXT_SCALE = 0.375f;
+
+// Redraw rate of the pulsing highlight of the selected decision
+
+constexpr double DECISION_PULSE_INTERVAL = 1.0 / 30.0; // seconds
+
 class Renderer
 {
 private:
+	struct Glyph
+	{
+		SDL_Rect atlasRect;
+		int32_t advance;
+	};
+
+	struct StreamingTexture
+	{
+		SDL_Texture* texture;
+		int32_t width;
+		int32_t height;
+		uint32_t uploadIndex; // Upload that brought the contents up to date, 0 if unknown
+	};
+
 	static SDL_Window* window;
 	static SDL_Renderer* renderer;
+	static std::string renderDriver; // Measured at startup if empty
 
 	static int32_t rendererWidth;
 	static int32_t rendererHeight;
@@ -19,30 +71,90 @@ private:
 	static SDL_Texture* currentTexture;
 	static int32_t currentTextureWidth;
 	static int32_t currentTextureHeight;
+	static TextureCache textureCache;
+	static std::mutex textureCacheMutex; // The game thread asks what is cached
+	static bool useStreamingTextures;
+	static std::vector<StreamingTexture> streamingTextures;
+	static uint32_t nativeTextureFormat;
+	static std::vector<uint8_t> stagingPixels;
+	static std::vector<SDL_Rect> dirtyRects;
+	static std::vector<uint8_t> uploadedPixels; // Last picture uploaded to a streaming texture
+	static int32_t uploadedWidth;
+	static int32_t uploadedHeight;
+	static uint32_t uploadCount;
+	static std::vector<SDL_Rect> previousDirtyRects; // From the picture before the last one to the last one
+	static int64_t previousDirtyPixels; // Negative if unknown
+
+	// With software scaling the picture is kept as a surface, and scaled to
+	// the viewport only when the picture or the viewport change
+
+	static SoftwareScalingModes softwareScalingMode;
+	static bool useSoftwareScaling;
+	static ScalingFilters softwareScalingFilter;
+	static SDL_Surface* currentSurface;
+	static SDL_Texture* scaledTexture;
+	static int32_t scaledTextureWidth;
+	static int32_t scaledTextureHeight;
+	static bool isScaledTextureValid;
 
 	static TTF_Font* textFont;
-	static SDL_Texture* currentTextTexture;
-	static int32_t currentTextTextureWidth;
-	static int32_t currentTextTextureHeight;
+	static SDL_Texture* glyphAtlas;
+	static Glyph glyphs[GLYPH_ATLAS_LAST - GLYPH_ATLAS_FIRST + 1];
+	static int32_t glyphHeight;
+	static int32_t glyphLineSkip;
+
+	static std::string scoreText;
+	static int32_t scoreTextWidth;
+	static int32_t scoreTextHeight;
+
+	static std::string overlayText;
+	static int32_t overlayTextWidth;
+	static int32_t overlayTextHeight;
+
+	static std::string framePictureFileName;
+	static std::string frameScoreText;
 
 public:
 	static bool Initialize(SDL_Window* window, const std::string fontPath);
 	static void Dispose();
 
+	static void SetFrame(const std::string baseDataPath, const FrameSnapshot& frame);
+	static void RenderFrame(const FrameSnapshot& frame);
+
 	static void Clear(const uint8_t r, const uint8_t g, const uint8_t b);
 	static void RenderPicture();
 	static void RenderDecisionSelection(const int32_t selectionX, const int32_t selectionY, const int32_t selectionW, const int32_t selectionH);
 	static void RenderScore();
+	static void RenderOverlay();
 	static void Present();
 
 	static void WindowSizeChanged(const int32_t width, const int32_t height);
 
 	static bool LoadPictureFromBMP(const std::string baseDataPath, const std::string fileName);
 	static bool GenerateScoreText(const std::string text);
+	static bool SetOverlayText(const std::string& text);
+
+	static void SetRenderDriver(const std::string& driverName);
+	static void SetTextureCacheBudget(const size_t bytes);
+	static void SetStreamingTextures(const bool enabled);
+	static void SetSoftwareScaling(const SoftwareScalingModes mode);
+	static bool IsPictureCached(const std::string& filePath);
+	inline static const TextureCacheStats& GetTextureCacheStats() { return textureCache.GetStats(); }
 
+	inline static uint32_t GetNativeTextureFormat() { return nativeTextureFormat; }
 	inline static bool IsInitialized() { return renderer != nullptr; }
 
 private:
+	static bool UpdateScaledTexture();
+	static SDL_Texture* UploadToStreamingTexture(SDL_Surface* surface, SDL_Texture* textureInUse);
+	static bool BuildGlyphAtlas();
+	static const Glyph& GetGlyph(const char character);
+	static int32_t GetKerning(const char previous, const char character);
+	static void MeasureText(const std::string& text, int32_t* width, int32_t* height);
+	static void RenderText(const std::string& text, const int32_t x, const int32_t y, const float scale);
+	static bool UploadDirtyRects(SDL_Texture* texture, const std::vector<SDL_Rect>& rects, const int32_t pitch);
+	static bool ConvertSurfacePixels(SDL_Surface* surface, uint8_t* pixels, const int32_t pitch);
+	static double GetElapsedMilliseconds(const Uint64 startTime);
 	static void UpdateViewport();
 	static void ScaleRect(SDL_Rect* rectToScale, const float scale);
 };
@@ -0,0 +1,192 @@
+#include "RendererProbe.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "Log.h"
+
+std::string RendererProbe::SelectDriver(SDL_Window* window)
+{
+	std::string key = GetMachineKey();
+	std::string driverName;
+
+	if (LoadCachedDriver(key, &driverName))
+	{
+		LOG_PRINT(LogTypes::Info, "Using render driver %s, measured on a previous launch.", driverName.c_str());
+		return driverName;
+	}
+
+	LOG_PRINT(LogTypes::Info, "Measuring the render drivers of %s...", key.c_str());
+
+	double bestFrameTime = -1.0;
+
+	for (int32_t d = 0; d < SDL_GetNumRenderDrivers(); d++)
+	{
+		SDL_RendererInfo driverInfo;
+		if (SDL_GetRenderDriverInfo(d, &driverInfo) < 0) continue;
+
+		double frameTime = MeasureDriver(window, d);
+
+		if (frameTime < 0.0)
+		{
+			LOG_PRINT(LogTypes::Warning, "Render driver %s can't be used: %s", driverInfo.name, SDL_GetError());
+			continue;
+		}
+
+		LOG_PRINT(LogTypes::Info, "Render driver %s: %.2f ms per frame.", driverInfo.name, frameTime);
+
+		if (bestFrameTime < 0.0 || frameTime < bestFrameTime)
+		{
+			bestFrameTime = frameTime;
+			driverName = driverInfo.name;
+		}
+	}
+
+	if (driverName.empty())
+	{
+		LOG_PRINT(LogTypes::Warning, "No render driver could be measured, SDL will choose one.");
+		return driverName;
+	}
+
+	LOG_PRINT(LogTypes::Info, "Chose render driver %s.", driverName.c_str());
+
+	SaveCachedDriver(key, driverName);
+
+	return driverName;
+}
+
+double RendererProbe::MeasureDriver(SDL_Window* window, const int32_t driverIndex)
+{
+	// Median milliseconds of a frame like the ones of the game: a picture
+	// upload and a stretch to the whole window. Negative if it fails.
+
+	SDL_Renderer* renderer = SDL_CreateRenderer(window, driverIndex, 0);
+	if (renderer == nullptr) return -1.0;
+
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+	SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, RENDERER_PROBE_WIDTH, RENDERER_PROBE_HEIGHT);
+
+	if (texture == nullptr)
+	{
+		SDL_DestroyRenderer(renderer);
+		return -1.0;
+	}
+
+	// A gradient rather than a flat color, so no driver can take a shortcut
+
+	std::vector<uint32_t> pixels(static_cast<size_t>(RENDERER_PROBE_WIDTH) * RENDERER_PROBE_HEIGHT);
+
+	for (int32_t y = 0; y < RENDERER_PROBE_HEIGHT; y++)
+	{
+		for (int32_t x = 0; x < RENDERER_PROBE_WIDTH; x++)
+			pixels[y * RENDERER_PROBE_WIDTH + x] = 0xFF000000 | ((x & 0xFF) << 16) | ((y & 0xFF) << 8) | ((x + y) & 0xFF);
+	}
+
+	std::vector<double> frameTimes;
+	SDL_Rect readRect = { 0, 0, 1, 1 };
+	uint32_t readPixel;
+	bool isWorking = true;
+
+	for (int32_t f = 0; f < RENDERER_PROBE_WARMUP_FRAMES + RENDERER_PROBE_FRAMES && isWorking; f++)
+	{
+		Uint64 startTime = SDL_GetPerformanceCounter();
+
+		// Reading a pixel back waits for the GPU, so the work it queued is measured too
+
+		isWorking = SDL_UpdateTexture(texture, NULL, pixels.data(), RENDERER_PROBE_WIDTH * sizeof(uint32_t)) == 0 &&
+			SDL_RenderClear(renderer) == 0 &&
+			SDL_RenderCopy(renderer, texture, NULL, NULL) == 0 &&
+			SDL_RenderReadPixels(renderer, &readRect, SDL_PIXELFORMAT_ARGB8888, &readPixel, sizeof(readPixel)) == 0;
+
+		SDL_RenderPresent(renderer);
+
+		if (f >= RENDERER_PROBE_WARMUP_FRAMES)
+			frameTimes.push_back((SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency());
+	}
+
+	// Don't leave the gradient on screen until the game draws
+
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+	SDL_RenderClear(renderer);
+	SDL_RenderPresent(renderer);
+
+	SDL_DestroyTexture(texture);
+	SDL_DestroyRenderer(renderer);
+
+	if (!isWorking || frameTimes.empty()) return -1.0;
+
+	std::nth_element(frameTimes.begin(), frameTimes.begin() + frameTimes.size() / 2, frameTimes.end());
+
+	return frameTimes[frameTimes.size() / 2];
+}
+
+std::string RendererProbe::GetMachineKey()
+{
+	// Everything that changes which driver is the fastest
+
+	SDL_version version;
+	SDL_GetVersion(&version);
+
+	const char* videoDriver = SDL_GetCurrentVideoDriver();
+	const char* displayName = SDL_GetDisplayName(0);
+
+	char text[512];
+	snprintf(text, sizeof(text), "%s, %s video, display %s, %i CPUs, %i MB, SDL %u.%u.%u", SDL_GetPlatform(), videoDriver != nullptr ? videoDriver : "no",
+		displayName != nullptr ? displayName : "unknown", SDL_GetCPUCount(), SDL_GetSystemRAM(), version.major, version.minor, version.patch);
+
+	std::string key = text;
+
+	for (int32_t d = 0; d < SDL_GetNumRenderDrivers(); d++)
+	{
+		SDL_RendererInfo driverInfo;
+		if (SDL_GetRenderDriverInfo(d, &driverInfo) == 0) key += std::string(d == 0 ? ", drivers " : " ") + driverInfo.name;
+	}
+
+	return key;
+}
+
+std::string RendererProbe::GetCacheFilePath()
+{
+	char* prefPath = SDL_GetPrefPath(PREF_ORGANIZATION, PREF_APPLICATION);
+
+	if (prefPath == nullptr)
+	{
+		LOG_PRINT(LogTypes::Warning, "There is no folder to save the render driver in: %s", SDL_GetError());
+		return std::string();
+	}
+
+	std::string filePath = std::string(prefPath) + RENDERER_PROBE_FILE_NAME;
+	SDL_free(prefPath);
+
+	return filePath;
+}
+
+bool RendererProbe::LoadCachedDriver(const std::string& key, std::string* driverName)
+{
+	// The key in the first line, the driver in the second
+
+	std::string filePath = GetCacheFilePath();
+	if (filePath.empty()) return false;
+
+	std::ifstream file(filePath);
+	if (!file.is_open()) return false;
+
+	std::string cachedKey;
+	if (!std::getline(file, cachedKey) || cachedKey != key) return false;
+
+	return std::getline(file, *driverName) && !driverName->empty();
+}
+
+void RendererProbe::SaveCachedDriver(const std::string& key, const std::string& driverName)
+{
+	std::string filePath = GetCacheFilePath();
+	if (filePath.empty()) return;
+
+	std::ofstream file(filePath, std::ios::trunc);
+	file << key << '\n' << driverName << '\n';
+
+	if (!file.good())
+		LOG_PRINT(LogTypes::Warning, "Can't save the render driver to %s", filePath.c_str());
+}
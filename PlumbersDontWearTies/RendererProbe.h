@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include <SDL.h>
+
+// Where SDL_GetPrefPath keeps the settings of the game
+
+constexpr const char* PREF_ORGANIZATION = "PlumbersDontWearTies";
+constexpr const char* PREF_APPLICATION = "PlumbersDontWearTies";
+constexpr const char* RENDERER_PROBE_FILE_NAME = "RenderDriver.txt";
+
+// Each driver uploads and stretches a picture of the size of the game's
+
+constexpr int32_t RENDERER_PROBE_WIDTH = 640;
+constexpr int32_t RENDERER_PROBE_HEIGHT = 480;
+constexpr int32_t RENDERER_PROBE_WARMUP_FRAMES = 3;
+constexpr int32_t RENDERER_PROBE_FRAMES = 15;
+
+// Chooses the render driver by timing a frame of the game on each one the
+// first time the game runs on a machine. The choice is saved with a key of
+// the machine and the SDL version, so later launches read it instead, and
+// a new GPU, video driver or SDL measures them again.
+
+class RendererProbe
+{
+public:
+	static std::string SelectDriver(SDL_Window* window);
+
+private:
+	static double MeasureDriver(SDL_Window* window, const int32_t driverIndex);
+	static std::string GetMachineKey();
+	static std::string GetCacheFilePath();
+	static bool LoadCachedDriver(const std::string& key, std::string* driverName);
+	static void SaveCachedDriver(const std::string& key, const std::string& driverName);
+};
@@ -0,0 +1,62 @@
+#include "RingBuffer.h"
+
+#include <cstring>
+
+RingBuffer::RingBuffer(const size_t capacity) : buffer(capacity), mask(capacity - 1), readIndex(0), writeIndex(0)
+{
+}
+
+size_t RingBuffer::Write(const uint8_t* data, const size_t bytes)
+{
+	size_t write = writeIndex.load(std::memory_order_relaxed);
+	size_t read = readIndex.load(std::memory_order_acquire);
+
+	size_t freeBytes = buffer.size() - (write - read);
+	size_t count = bytes < freeBytes ? bytes : freeBytes;
+
+	size_t start = write & mask;
+	size_t firstPart = buffer.size() - start;
+	if (firstPart > count) firstPart = count;
+
+	memcpy(buffer.data() + start, data, firstPart);
+	memcpy(buffer.data(), data + firstPart, count - firstPart);
+
+	writeIndex.store(write + count, std::memory_order_release);
+
+	return count;
+}
+
+size_t RingBuffer::GetFreeBytes() const
+{
+	return buffer.size() - (writeIndex.load(std::memory_order_relaxed) - readIndex.load(std::memory_order_acquire));
+}
+
+size_t RingBuffer::Read(uint8_t* data, const size_t bytes)
+{
+	size_t read = readIndex.load(std::memory_order_relaxed);
+	size_t write = writeIndex.load(std::memory_order_acquire);
+
+	size_t availableBytes = write - read;
+	size_t count = bytes < availableBytes ? bytes : availableBytes;
+
+	size_t start = read & mask;
+	size_t firstPart = buffer.size() - start;
+	if (firstPart > count) firstPart = count;
+
+	memcpy(data, buffer.data() + start, firstPart);
+	memcpy(data + firstPart, buffer.data(), count - firstPart);
+
+	readIndex.store(read + count, std::memory_order_release);
+
+	return count;
+}
+
+void RingBuffer::Discard()
+{
+	readIndex.store(writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t RingBuffer::GetAvailableBytes() const
+{
+	return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_relaxed);
+}
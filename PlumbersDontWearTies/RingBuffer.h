@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lock-free byte ring buffer for exactly one producer thread and one consumer
+// thread. Indices grow forever and are wrapped with a mask, so the capacity
+// must be a power of two.
+
+class RingBuffer
+{
+private:
+	std::vector<uint8_t> buffer;
+	size_t mask;
+	std::atomic<size_t> readIndex;
+	std::atomic<size_t> writeIndex;
+
+public:
+	RingBuffer(const size_t capacity);
+
+	// Producer side
+	size_t Write(const uint8_t* data, const size_t bytes);
+	size_t GetFreeBytes() const;
+
+	// Consumer side
+	size_t Read(uint8_t* data, const size_t bytes);
+	void Discard();
+	size_t GetAvailableBytes() const;
+
+	inline size_t GetCapacity() const { return buffer.size(); }
+};
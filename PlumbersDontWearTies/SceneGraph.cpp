@@ -0,0 +1,204 @@
+#include "SceneGraph.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "AssetArchive.h"
+#include "Log.h"
+
+bool SceneGraph::Load(const std::string& baseDataPath)
+{
+	// Read GAME.BIN, from the archive if there is one
+
+	const uint8_t* data;
+	size_t size;
+	std::vector<uint8_t> fileData;
+
+	if (!AssetArchive::Find(baseDataPath + "GAME.BIN", &data, &size))
+	{
+		std::ifstream gameBinStream(baseDataPath + "GAME.BIN", std::ios::binary | std::ios::ate);
+
+		if (!gameBinStream.is_open())
+		{
+			LOG_PRINT(LogTypes::Critical, "GAME.BIN has not been found.");
+			return false;
+		}
+
+		std::streamoff fileSize = gameBinStream.tellg();
+		fileData.resize(static_cast<size_t>(fileSize));
+
+		gameBinStream.seekg(0, std::ios_base::beg);
+		gameBinStream.read(reinterpret_cast<char*>(fileData.data()), fileSize);
+
+		data = fileData.data();
+		size = static_cast<size_t>(gameBinStream.gcount());
+	}
+
+	GameDefinition gameData;
+	bool isCompiled = GameDataLoader::Load(data, size, &gameData) && Compile(gameData, baseDataPath);
+
+	if (!isCompiled) LOG_PRINT(LogTypes::Critical, "GAME.BIN is not valid.");
+
+	return isCompiled;
+}
+
+bool SceneGraph::Compile(const GameDefinition& gameData, const std::string& baseDataPath)
+{
+	Clear();
+
+	int32_t numScenes = static_cast<int32_t>(gameData.scenes.size());
+	int32_t numPics = static_cast<int32_t>(gameData.pictures.size());
+
+	if (numScenes == 0)
+	{
+		LOG_PRINT(LogTypes::Error, "GAME.BIN doesn't have any scene.");
+		return false;
+	}
+
+	// Map scene IDs to indices. If an ID is repeated the first scene wins,
+	// same as searching the folder names in order.
+
+	for (int32_t s = 0; s < numScenes; s++)
+	{
+		int32_t id;
+		if (ParseSceneID(gameData.scenes[s].szSceneFolder, &id)) sceneIndicesByID.insert(std::make_pair(id, s));
+	}
+
+	// Build the scenes and their pictures
+
+	scenes.resize(numScenes);
+	pictures.reserve(numPics);
+
+	for (int32_t s = 0; s < numScenes; s++)
+	{
+		const _sceneDefEx* sceneDef = &gameData.scenes[s];
+		SceneNode* scene = &scenes[s];
+
+		scene->name = GetString(sceneDef->szSceneFolder, sizeof(sceneDef->szSceneFolder));
+		BuildAssetPath(baseDataPath, sceneDef->szSceneFolder, sceneDef->szDialogWav, &scene->dialogWav);
+		BuildAssetPath(baseDataPath, sceneDef->szSceneFolder, sceneDef->szDecisionBmp, &scene->decisionBmp);
+
+		int32_t scenePics = sceneDef->numPics;
+
+		if (sceneDef->pictureIndex < 0 || scenePics < 0 || static_cast<int64_t>(sceneDef->pictureIndex) + scenePics > numPics)
+		{
+			LOG_PRINT(LogTypes::Warning, "Scene %s has invalid pictures, ignoring them.", scene->name.c_str());
+			scenePics = 0;
+		}
+
+		scene->firstPicture = static_cast<int32_t>(pictures.size());
+		scene->numPics = scenePics;
+
+		double endTime = 0.0;
+
+		for (int32_t p = 0; p < scenePics; p++)
+		{
+			const _pictureDef* pictureDef = &gameData.pictures[sceneDef->pictureIndex + p];
+
+			PictureNode picture;
+			BuildAssetPath(baseDataPath, sceneDef->szSceneFolder, pictureDef->szBitmapFile, &picture.bitmap);
+			picture.startTime = endTime;
+			endTime += pictureDef->duration / 10.0;
+			picture.endTime = endTime;
+
+			pictures.push_back(picture);
+		}
+
+		// Resolve where each action leads
+
+		scene->numActions = static_cast<int16_t>(sceneDef->numActions < 0 ? 0 : sceneDef->numActions > SCENE_MAX_ACTIONS ? SCENE_MAX_ACTIONS : sceneDef->numActions);
+
+		for (int16_t a = 0; a < SCENE_MAX_ACTIONS; a++)
+		{
+			const _actionDefEx* actionDef = &sceneDef->actions[a];
+			ActionNode* action = &scene->actions[a];
+
+			action->scoreDelta = actionDef->scoreDelta;
+			action->sceneSegment = actionDef->sceneSegment;
+			action->hotspotX = actionDef->cHotspotTopLeft.x;
+			action->hotspotY = actionDef->cHotspotTopLeft.y;
+			action->hotspotWidth = actionDef->cHotspotBottomRigh.x - actionDef->cHotspotTopLeft.x;
+			action->hotspotHeight = actionDef->cHotspotBottomRigh.y - actionDef->cHotspotTopLeft.y;
+
+			if (actionDef->nextSceneID == SCENEID_EX_ENDGAME)
+			{
+				action->nextSceneIndex = SCENE_INDEX_ENDGAME;
+			}
+			else if (actionDef->nextSceneID == SCENEID_PREVDECISION)
+			{
+				action->nextSceneIndex = SCENE_INDEX_PREVDECISION;
+			}
+			else
+			{
+				action->nextSceneIndex = GetSceneIndex(actionDef->nextSceneID);
+
+				if (a < scene->numActions && sceneIndicesByID.find(actionDef->nextSceneID) == sceneIndicesByID.end())
+					LOG_PRINT(LogTypes::Warning, "Scene %s leads to unknown scene ID %i.", scene->name.c_str(), actionDef->nextSceneID);
+			}
+		}
+	}
+
+	LOG_PRINT(LogTypes::Info, "Scene graph compiled: %i scenes, %i pictures.", GetNumScenes(), static_cast<int32_t>(pictures.size()));
+
+	return true;
+}
+
+void SceneGraph::Clear()
+{
+	scenes.clear();
+	pictures.clear();
+	sceneIndicesByID.clear();
+}
+
+int32_t SceneGraph::GetSceneIndex(const int32_t id) const
+{
+	// Unknown IDs go to the first scene
+
+	auto it = sceneIndicesByID.find(id);
+	if (it == sceneIndicesByID.end()) return 0;
+
+	return it->second;
+}
+
+bool SceneGraph::ParseSceneID(const char* sceneFolder, int32_t* id)
+{
+	// Folder names must be "SCxx", where xx is the ID with at least 2 digits
+
+	std::string name = GetString(sceneFolder, sizeof(_sceneDefEx::szSceneFolder));
+	if (name.size() < 4 || name.size() > 11 || name[0] != 'S' || name[1] != 'C') return false;
+
+	int64_t value = 0;
+	for (size_t c = 2; c < name.size(); c++)
+	{
+		if (!isdigit(static_cast<unsigned char>(name[c]))) return false;
+		value = value * 10 + (name[c] - '0');
+	}
+
+	if (value >= SCENEID_EX_ENDGAME) return false;
+
+	char canonicalName[16];
+	snprintf(canonicalName, sizeof(canonicalName), "SC%02d", static_cast<int32_t>(value));
+	if (name != canonicalName) return false;
+
+	*id = static_cast<int32_t>(value);
+	return true;
+}
+
+void SceneGraph::BuildAssetPath(const std::string& baseDataPath, const char* sceneFolder, const char* fileName, AssetPath* assetPath)
+{
+	assetPath->fileName = GetString(sceneFolder, sizeof(_sceneDefEx::szSceneFolder)) + "/" + GetString(fileName, sizeof(_sceneDefEx::szDialogWav));
+
+	for (auto& c : assetPath->fileName)
+		c = toupper(c);
+
+	assetPath->filePath = baseDataPath + assetPath->fileName;
+}
+
+std::string SceneGraph::GetString(const char* text, const size_t maxLength)
+{
+	// Strings in GAME.BIN don't need to be null terminated if they fill the field
+
+	return std::string(text, strnlen(text, maxLength));
+}
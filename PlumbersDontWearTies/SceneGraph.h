@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GameDataLoader.h"
+
+// Next scene indices with a special meaning
+
+constexpr int32_t SCENE_INDEX_PREVDECISION = -1;
+constexpr int32_t SCENE_INDEX_ENDGAME = -2;
+
+constexpr int16_t SCENE_MAX_ACTIONS = 3;
+
+struct AssetPath
+{
+	std::string fileName; // Relative to the data folder, upper case
+	std::string filePath; // Including the data folder
+};
+
+struct ActionNode
+{
+	int32_t scoreDelta;
+	int32_t nextSceneIndex;
+	int16_t sceneSegment;
+	int32_t hotspotX;
+	int32_t hotspotY;
+	int32_t hotspotWidth;
+	int32_t hotspotHeight;
+};
+
+struct PictureNode
+{
+	AssetPath bitmap;
+	double startTime; // seconds since the beginning of the scene
+	double endTime; // seconds since the beginning of the scene
+};
+
+struct SceneNode
+{
+	std::string name;
+	AssetPath dialogWav;
+	AssetPath decisionBmp;
+	int32_t firstPicture;
+	int32_t numPics;
+	int16_t numActions;
+	ActionNode actions[SCENE_MAX_ACTIONS];
+};
+
+// Runtime form of GAME.BIN, built once when the game is loaded. Scene IDs are
+// resolved to indices, asset paths are built and picture times are summed up
+// front, so moving through the game doesn't need any searching or allocation.
+
+class SceneGraph
+{
+private:
+	std::vector<SceneNode> scenes;
+	std::vector<PictureNode> pictures;
+	std::unordered_map<int32_t, int32_t> sceneIndicesByID;
+
+public:
+	bool Load(const std::string& baseDataPath);
+	bool Compile(const GameDefinition& gameData, const std::string& baseDataPath);
+	void Clear();
+
+	int32_t GetSceneIndex(const int32_t id) const;
+
+	inline bool IsCompiled() const { return !scenes.empty(); }
+	inline int32_t GetNumScenes() const { return static_cast<int32_t>(scenes.size()); }
+	inline const SceneNode& GetScene(const int32_t sceneIndex) const { return scenes[sceneIndex]; }
+	inline const PictureNode& GetPicture(const SceneNode& scene, const int32_t pictureIndex) const { return pictures[scene.firstPicture + pictureIndex]; }
+
+private:
+	static bool ParseSceneID(const char* sceneFolder, int32_t* id);
+	static void BuildAssetPath(const std::string& baseDataPath, const char* sceneFolder, const char* fileName, AssetPath* assetPath);
+	static std::string GetString(const char* text, const size_t maxLength);
+};
@@ -0,0 +1,76 @@
+#include "Simulation.h"
+
+#include <random>
+
+#include "Game.h"
+
+void Simulation::SetDefaultOptions(SimulationOptions* options)
+{
+	options->timeStep = SIMULATION_DEFAULT_TIME_STEP;
+	options->skipPictures = false;
+	options->maxTransitions = SIMULATION_DEFAULT_MAX_TRANSITIONS;
+	options->seed = 0;
+	options->choices.clear();
+}
+
+void Simulation::Run(Game* game, const SimulationOptions& options, SimulationResult* result)
+{
+	*result = {};
+
+	std::mt19937 random(options.seed);
+	size_t nextChoice = 0;
+
+	game->Start();
+
+	while (game->IsRunning() && result->transitions < options.maxTransitions)
+	{
+		GameStates state = game->GetState();
+
+		// Feed the input a player would give in this state, once the game
+		// would be sleeping, so the preload of the decision branches gets the
+		// update it needs before the player chooses
+
+		if (state == GameStates::WaitingDecision && game->GetNextDeadline() != 0.0)
+		{
+			int16_t numDecisions = game->GetNumDecisions();
+			int8_t decision;
+
+			// A decision screen without decisions can't be left
+			if (numDecisions <= 0) break;
+
+			if (nextChoice < options.choices.size())
+				decision = options.choices[nextChoice++];
+			else
+				decision = static_cast<int8_t>(std::uniform_int_distribution<int32_t>(0, numDecisions - 1)(random));
+
+			if (decision < 0 || decision >= numDecisions) decision = 0;
+
+			if (game->AreDecisionBranchesPreloaded()) result->preloadedDecisions++;
+
+			game->SelectDecision(decision);
+			game->AdvancePicture();
+			result->decisions++;
+		}
+		else if (state == GameStates::WaitingPicture && options.skipPictures)
+		{
+			game->AdvancePicture();
+		}
+
+		if (game->GetState() != state)
+		{
+			result->transitions++;
+			state = game->GetState();
+		}
+
+		game->Update(options.timeStep);
+		result->updates++;
+		result->simulatedTime += options.timeStep;
+
+		if (game->GetState() != state) result->transitions++;
+	}
+
+	result->score = game->GetScore();
+	result->hasEnded = !game->IsRunning();
+
+	game->Stop();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Game;
+
+constexpr double SIMULATION_DEFAULT_TIME_STEP = 0.1; // seconds, picture durations are in deciseconds
+constexpr uint64_t SIMULATION_DEFAULT_MAX_TRANSITIONS = 100000;
+
+struct SimulationOptions
+{
+	double timeStep; // simulated seconds per update
+	bool skipPictures; // call AdvancePicture instead of waiting for each picture
+	uint64_t maxTransitions; // stop a playthrough that doesn't reach the end
+	uint32_t seed; // for the decisions that aren't scripted
+	std::vector<int8_t> choices; // scripted decisions, 0 based, in order
+};
+
+struct SimulationResult
+{
+	uint64_t updates;
+	uint64_t transitions;
+	uint32_t decisions;
+	uint32_t preloadedDecisions; // whose branches were preloaded before the input
+	int32_t score;
+	double simulatedTime; // seconds
+	bool hasEnded;
+};
+
+// Runs the game state machine with a simulated clock instead of real time.
+// Renderer and Audio are not initialized, so they do nothing when the game
+// calls them, and input comes from the options instead of the player. Like
+// the game thread, the input is only given when the game has nothing to do
+// right away.
+
+class Simulation
+{
+public:
+	static void SetDefaultOptions(SimulationOptions* options);
+	static void Run(Game* game, const SimulationOptions& options, SimulationResult* result);
+};
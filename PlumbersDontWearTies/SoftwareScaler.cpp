@@ -0,0 +1,334 @@
+#include "SoftwareScaler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SOFTWARESCALER_X86
+#include <immintrin.h>
+#endif
+
+#if defined(SOFTWARESCALER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SOFTWARESCALER_TARGET(x) __attribute__((target(x)))
+#else
+#define SOFTWARESCALER_TARGET(x)
+#endif
+
+// Bilinear weights are in 1/256 of a pixel, so a blended channel fits in 16 bits
+
+constexpr int32_t BILINEAR_WEIGHT_ONE = 256;
+
+static inline const uint32_t* GetRow(const SDL_Surface* surface, const int32_t y)
+{
+	return reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch);
+}
+
+static inline uint32_t* GetRow(uint8_t* pixels, const int32_t pitch, const int32_t y)
+{
+	return reinterpret_cast<uint32_t*>(pixels + static_cast<size_t>(y) * pitch);
+}
+
+static inline uint32_t BlendPixels(const uint32_t pixel0, const uint32_t pixel1, const uint32_t weight)
+{
+	uint32_t result = 0;
+
+	for (int32_t shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t channel0 = (pixel0 >> shift) & 0xFF;
+		uint32_t channel1 = (pixel1 >> shift) & 0xFF;
+		result |= (((channel0 * (BILINEAR_WEIGHT_ONE - weight) + channel1 * weight) >> 8) & 0xFF) << shift;
+	}
+
+	return result;
+}
+
+void SoftwareScaler::Scale(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch, const ScalingFilters filter)
+{
+	if (source->w <= 0 || source->h <= 0 || targetWidth <= 0 || targetHeight <= 0) return;
+
+	if (targetWidth % source->w == 0 && targetHeight % source->h == 0)
+		ScaleInteger(source, target, targetWidth, targetHeight, targetPitch);
+	else if (filter == ScalingFilters::Nearest)
+		ScaleNearest(source, target, targetWidth, targetHeight, targetPitch);
+	else
+		ScaleBilinear(source, target, targetWidth, targetHeight, targetPitch);
+}
+
+void SoftwareScaler::ScaleInteger(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch)
+{
+	// Each source row is widened once and then copied to the rows below it
+
+	int32_t factorX = targetWidth / source->w;
+	int32_t factorY = targetHeight / source->h;
+	size_t rowBytes = static_cast<size_t>(targetWidth) * sizeof(uint32_t);
+
+	for (int32_t y = 0; y < source->h; y++)
+	{
+		uint32_t* firstRow = GetRow(target, targetPitch, y * factorY);
+		RepeatRow(GetRow(source, y), firstRow, source->w, factorX);
+
+		for (int32_t r = 1; r < factorY; r++)
+			memcpy(GetRow(target, targetPitch, y * factorY + r), firstRow, rowBytes);
+	}
+}
+
+void SoftwareScaler::ScaleNearest(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch)
+{
+	std::vector<int32_t> columns(targetWidth);
+
+	for (int32_t x = 0; x < targetWidth; x++)
+		columns[x] = static_cast<int32_t>((static_cast<int64_t>(2 * x + 1) * source->w) / (2 * targetWidth));
+
+	int32_t previousSourceY = -1;
+	size_t rowBytes = static_cast<size_t>(targetWidth) * sizeof(uint32_t);
+
+	for (int32_t y = 0; y < targetHeight; y++)
+	{
+		int32_t sourceY = static_cast<int32_t>((static_cast<int64_t>(2 * y + 1) * source->h) / (2 * targetHeight));
+		uint32_t* targetRow = GetRow(target, targetPitch, y);
+
+		if (sourceY == previousSourceY)
+			memcpy(targetRow, GetRow(target, targetPitch, y - 1), rowBytes);
+		else
+			GatherRow(GetRow(source, sourceY), targetRow, columns.data(), targetWidth);
+
+		previousSourceY = sourceY;
+	}
+}
+
+void SoftwareScaler::ScaleBilinear(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch)
+{
+	// The two source rows are blended first, then each target pixel blends
+	// two neighbours of that row. The extra pixel repeats the last one, so
+	// the right edge can always read a pair.
+
+	std::vector<int32_t> columns(targetWidth);
+	std::vector<uint16_t> weights(targetWidth);
+	std::vector<uint32_t> blendedRow(source->w + 1);
+
+	for (int32_t x = 0; x < targetWidth; x++)
+	{
+		int32_t position = GetSourcePosition(x, source->w, targetWidth);
+		columns[x] = position >> 8;
+		weights[x] = static_cast<uint16_t>(position & 0xFF);
+	}
+
+	int32_t previousPosition = -1;
+	size_t rowBytes = static_cast<size_t>(targetWidth) * sizeof(uint32_t);
+
+	for (int32_t y = 0; y < targetHeight; y++)
+	{
+		int32_t position = GetSourcePosition(y, source->h, targetHeight);
+		uint32_t* targetRow = GetRow(target, targetPitch, y);
+
+		if (position == previousPosition)
+		{
+			memcpy(targetRow, GetRow(target, targetPitch, y - 1), rowBytes);
+			continue;
+		}
+
+		int32_t sourceY = position >> 8;
+		int32_t nextSourceY = std::min(sourceY + 1, source->h - 1);
+
+		BlendRows(GetRow(source, sourceY), GetRow(source, nextSourceY), blendedRow.data(), source->w, static_cast<uint16_t>(position & 0xFF));
+		blendedRow[source->w] = blendedRow[source->w - 1];
+
+		BlendColumns(blendedRow.data(), targetRow, columns.data(), weights.data(), targetWidth);
+
+		previousPosition = position;
+	}
+}
+
+int32_t SoftwareScaler::GetSourcePosition(const int32_t targetPosition, const int32_t sourceSize, const int32_t targetSize)
+{
+	// Center of the target pixel in source pixels, in 1/256 of a pixel
+
+	int64_t position = (static_cast<int64_t>(2 * targetPosition + 1) * sourceSize * BILINEAR_WEIGHT_ONE) / (2 * targetSize) - BILINEAR_WEIGHT_ONE / 2;
+
+	return static_cast<int32_t>(std::max<int64_t>(0, std::min<int64_t>(position, static_cast<int64_t>(sourceSize - 1) * BILINEAR_WEIGHT_ONE)));
+}
+
+void SoftwareScaler::RepeatRow(const uint32_t* source, uint32_t* target, const int32_t count, const int32_t factor)
+{
+	typedef void (*RepeatRowFunction)(const uint32_t*, uint32_t*, const int32_t, const int32_t);
+
+	static const RepeatRowFunction repeatRow =
+		SDL_HasSSE2() ? &RepeatRowSSE2 :
+		&RepeatRowScalar;
+
+	repeatRow(source, target, count, factor);
+}
+
+void SoftwareScaler::RepeatRowScalar(const uint32_t* source, uint32_t* target, const int32_t count, const int32_t factor)
+{
+	for (int32_t i = 0; i < count; i++)
+	{
+		for (int32_t f = 0; f < factor; f++)
+			*target++ = source[i];
+	}
+}
+
+SOFTWARESCALER_TARGET("sse2")
+void SoftwareScaler::RepeatRowSSE2(const uint32_t* source, uint32_t* target, const int32_t count, const int32_t factor)
+{
+#ifdef SOFTWARESCALER_X86
+	// Twice and four times, the common window sizes, are shuffles of 4 pixels
+
+	int32_t i = 0;
+
+	if (factor == 2)
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * 2), _mm_unpacklo_epi32(pixels, pixels));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * 2 + 4), _mm_unpackhi_epi32(pixels, pixels));
+		}
+	}
+	else if (factor == 4)
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * 4), _mm_shuffle_epi32(pixels, 0x00));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * 4 + 4), _mm_shuffle_epi32(pixels, 0x55));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * 4 + 8), _mm_shuffle_epi32(pixels, 0xAA));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * 4 + 12), _mm_shuffle_epi32(pixels, 0xFF));
+		}
+	}
+
+	RepeatRowScalar(source + i, target + i * factor, count - i, factor);
+#else
+	RepeatRowScalar(source, target, count, factor);
+#endif
+}
+
+void SoftwareScaler::GatherRow(const uint32_t* source, uint32_t* target, const int32_t* columns, const int32_t count)
+{
+	typedef void (*GatherRowFunction)(const uint32_t*, uint32_t*, const int32_t*, const int32_t);
+
+	static const GatherRowFunction gatherRow =
+		SDL_HasAVX2() ? &GatherRowAVX2 :
+		&GatherRowScalar;
+
+	gatherRow(source, target, columns, count);
+}
+
+void SoftwareScaler::GatherRowScalar(const uint32_t* source, uint32_t* target, const int32_t* columns, const int32_t count)
+{
+	for (int32_t i = 0; i < count; i++)
+		target[i] = source[columns[i]];
+}
+
+SOFTWARESCALER_TARGET("avx2")
+void SoftwareScaler::GatherRowAVX2(const uint32_t* source, uint32_t* target, const int32_t* columns, const int32_t count)
+{
+#ifdef SOFTWARESCALER_X86
+	int32_t i = 0;
+	const int32_t* pixels = reinterpret_cast<const int32_t*>(source);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), _mm256_i32gather_epi32(pixels, indices, 4));
+	}
+
+	GatherRowScalar(source, target + i, columns + i, count - i);
+#else
+	GatherRowScalar(source, target, columns, count);
+#endif
+}
+
+void SoftwareScaler::BlendRows(const uint32_t* row0, const uint32_t* row1, uint32_t* target, const int32_t count, const uint16_t weight)
+{
+	typedef void (*BlendRowsFunction)(const uint32_t*, const uint32_t*, uint32_t*, const int32_t, const uint16_t);
+
+	static const BlendRowsFunction blendRows =
+		SDL_HasSSE2() ? &BlendRowsSSE2 :
+		&BlendRowsScalar;
+
+	blendRows(row0, row1, target, count, weight);
+}
+
+void SoftwareScaler::BlendRowsScalar(const uint32_t* row0, const uint32_t* row1, uint32_t* target, const int32_t count, const uint16_t weight)
+{
+	for (int32_t i = 0; i < count; i++)
+		target[i] = BlendPixels(row0[i], row1[i], weight);
+}
+
+SOFTWARESCALER_TARGET("sse2")
+void SoftwareScaler::BlendRowsSSE2(const uint32_t* row0, const uint32_t* row1, uint32_t* target, const int32_t count, const uint16_t weight)
+{
+#ifdef SOFTWARESCALER_X86
+	// 4 pixels at a time, with their channels widened to 16 bits
+
+	int32_t i = 0;
+	__m128i zero = _mm_setzero_si128();
+	__m128i weight0 = _mm_set1_epi16(static_cast<short>(BILINEAR_WEIGHT_ONE - weight));
+	__m128i weight1 = _mm_set1_epi16(static_cast<short>(weight));
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i pixels0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i));
+		__m128i pixels1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i));
+
+		__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels0, zero), weight0), _mm_mullo_epi16(_mm_unpacklo_epi8(pixels1, zero), weight1));
+		__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels0, zero), weight0), _mm_mullo_epi16(_mm_unpackhi_epi8(pixels1, zero), weight1));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+	}
+
+	BlendRowsScalar(row0 + i, row1 + i, target + i, count - i, weight);
+#else
+	BlendRowsScalar(row0, row1, target, count, weight);
+#endif
+}
+
+void SoftwareScaler::BlendColumns(const uint32_t* row, uint32_t* target, const int32_t* columns, const uint16_t* weights, const int32_t count)
+{
+	typedef void (*BlendColumnsFunction)(const uint32_t*, uint32_t*, const int32_t*, const uint16_t*, const int32_t);
+
+	static const BlendColumnsFunction blendColumns =
+		SDL_HasSSE2() ? &BlendColumnsSSE2 :
+		&BlendColumnsScalar;
+
+	blendColumns(row, target, columns, weights, count);
+}
+
+void SoftwareScaler::BlendColumnsScalar(const uint32_t* row, uint32_t* target, const int32_t* columns, const uint16_t* weights, const int32_t count)
+{
+	for (int32_t i = 0; i < count; i++)
+		target[i] = BlendPixels(row[columns[i]], row[columns[i] + 1], weights[i]);
+}
+
+SOFTWARESCALER_TARGET("sse2")
+void SoftwareScaler::BlendColumnsSSE2(const uint32_t* row, uint32_t* target, const int32_t* columns, const uint16_t* weights, const int32_t count)
+{
+#ifdef SOFTWARESCALER_X86
+	// Each target pixel loads the pair of pixels it sits between, so one
+	// register holds both pairs of 2 target pixels and their weights
+
+	int32_t i = 0;
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128i pair0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + columns[i])), zero);
+		__m128i pair1 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + columns[i + 1])), zero);
+
+		short weight0 = static_cast<short>(weights[i]), inverse0 = static_cast<short>(BILINEAR_WEIGHT_ONE - weights[i]);
+		short weight1 = static_cast<short>(weights[i + 1]), inverse1 = static_cast<short>(BILINEAR_WEIGHT_ONE - weights[i + 1]);
+
+		pair0 = _mm_mullo_epi16(pair0, _mm_set_epi16(weight0, weight0, weight0, weight0, inverse0, inverse0, inverse0, inverse0));
+		pair1 = _mm_mullo_epi16(pair1, _mm_set_epi16(weight1, weight1, weight1, weight1, inverse1, inverse1, inverse1, inverse1));
+
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(pair0, pair1), _mm_unpackhi_epi64(pair0, pair1));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(target + i), _mm_packus_epi16(_mm_srli_epi16(sum, 8), zero));
+	}
+
+	BlendColumnsScalar(row, target + i, columns + i, weights + i, count - i);
+#else
+	BlendColumnsScalar(row, target, columns, weights, count);
+#endif
+}
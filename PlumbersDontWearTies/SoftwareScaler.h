@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <SDL.h>
+
+enum class ScalingFilters
+{
+	Nearest,
+	Bilinear
+};
+
+// Scales 32 bit pictures on the CPU, for renderers without a GPU that would
+// otherwise stretch the picture with a generic blit on every frame. Each byte
+// of a pixel is filtered on its own, so any 32 bit format works. When the
+// target is an exact multiple of the source both filters give the same
+// result, so pixels are just repeated.
+
+class SoftwareScaler
+{
+public:
+	static void Scale(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch, const ScalingFilters filter);
+
+private:
+	static void ScaleInteger(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch);
+	static void ScaleNearest(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch);
+	static void ScaleBilinear(const SDL_Surface* source, uint8_t* target, const int32_t targetWidth, const int32_t targetHeight, const int32_t targetPitch);
+	static int32_t GetSourcePosition(const int32_t targetPosition, const int32_t sourceSize, const int32_t targetSize);
+
+	static void RepeatRow(const uint32_t* source, uint32_t* target, const int32_t count, const int32_t factor);
+	static void RepeatRowScalar(const uint32_t* source, uint32_t* target, const int32_t count, const int32_t factor);
+	static void RepeatRowSSE2(const uint32_t* source, uint32_t* target, const int32_t count, const int32_t factor);
+
+	static void GatherRow(const uint32_t* source, uint32_t* target, const int32_t* columns, const int32_t count);
+	static void GatherRowScalar(const uint32_t* source, uint32_t* target, const int32_t* columns, const int32_t count);
+	static void GatherRowAVX2(const uint32_t* source, uint32_t* target, const int32_t* columns, const int32_t count);
+
+	static void BlendRows(const uint32_t* row0, const uint32_t* row1, uint32_t* target, const int32_t count, const uint16_t weight);
+	static void BlendRowsScalar(const uint32_t* row0, const uint32_t* row1, uint32_t* target, const int32_t count, const uint16_t weight);
+	static void BlendRowsSSE2(const uint32_t* row0, const uint32_t* row1, uint32_t* target, const int32_t count, const uint16_t weight);
+
+	static void BlendColumns(const uint32_t* row, uint32_t* target, const int32_t* columns, const uint16_t* weights, const int32_t count);
+	static void BlendColumnsScalar(const uint32_t* row, uint32_t* target, const int32_t* columns, const uint16_t* weights, const int32_t count);
+	static void BlendColumnsSSE2(const uint32_t* row, uint32_t* target, const int32_t* columns, const uint16_t* weights, const int32_t count);
+};
@@ -0,0 +1,94 @@
+#include "TextureCache.h"
+
+TextureCache::TextureCache()
+{
+	SDL_memset(&stats, 0, sizeof(stats));
+	stats.budgetBytes = TEXTURE_CACHE_DEFAULT_BUDGET;
+}
+
+TextureCache::~TextureCache()
+{
+	// Textures must be destroyed with Clear() while the renderer is still alive.
+}
+
+SDL_Texture* TextureCache::Get(const std::string& key, int32_t* width, int32_t* height)
+{
+	auto it = entriesByKey.find(key);
+	if (it == entriesByKey.end())
+	{
+		stats.misses++;
+		return nullptr;
+	}
+
+	// Move it to the front, it is the most recently used now
+
+	entries.splice(entries.begin(), entries, it->second);
+
+	stats.hits++;
+	*width = it->second->width;
+	*height = it->second->height;
+	return it->second->texture;
+}
+
+void TextureCache::Add(const std::string& key, SDL_Texture* texture, const int32_t width, const int32_t height)
+{
+	auto it = entriesByKey.find(key);
+	if (it != entriesByKey.end())
+	{
+		stats.usedBytes -= it->second->bytes;
+		if (it->second->texture != texture) SDL_DestroyTexture(it->second->texture);
+		entries.erase(it->second);
+		entriesByKey.erase(it);
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.texture = texture;
+	entry.width = width;
+	entry.height = height;
+	entry.bytes = static_cast<size_t>(width) * height * 4;
+
+	entries.push_front(entry);
+	entriesByKey[key] = entries.begin();
+	stats.usedBytes += entry.bytes;
+
+	EvictToBudget();
+
+	stats.entries = static_cast<uint32_t>(entries.size());
+}
+
+void TextureCache::SetBudget(const size_t bytes)
+{
+	stats.budgetBytes = bytes;
+
+	EvictToBudget();
+
+	stats.entries = static_cast<uint32_t>(entries.size());
+}
+
+void TextureCache::Clear()
+{
+	for (Entry& entry : entries)
+		SDL_DestroyTexture(entry.texture);
+
+	entries.clear();
+	entriesByKey.clear();
+
+	stats.usedBytes = 0;
+	stats.entries = 0;
+}
+
+void TextureCache::EvictToBudget()
+{
+	while (stats.usedBytes > stats.budgetBytes && entries.size() > 1)
+	{
+		Entry& last = entries.back();
+
+		SDL_DestroyTexture(last.texture);
+		stats.usedBytes -= last.bytes;
+		stats.evictions++;
+
+		entriesByKey.erase(last.key);
+		entries.pop_back();
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <SDL.h>
+
+constexpr size_t TEXTURE_CACHE_DEFAULT_BUDGET = 64 * 1024 * 1024; // bytes
+
+struct TextureCacheStats
+{
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t entries;
+	size_t usedBytes;
+	size_t budgetBytes;
+};
+
+// Keeps already uploaded pictures keyed by their path, evicting the least
+// recently used ones when the estimated memory exceeds the budget. The most
+// recently used entry is the one on screen, so it is never evicted.
+
+class TextureCache
+{
+private:
+	struct Entry
+	{
+		std::string key;
+		SDL_Texture* texture;
+		int32_t width;
+		int32_t height;
+		size_t bytes;
+	};
+
+	std::list<Entry> entries;
+	std::unordered_map<std::string, std::list<Entry>::iterator> entriesByKey;
+	TextureCacheStats stats;
+
+public:
+	TextureCache();
+	~TextureCache();
+
+	SDL_Texture* Get(const std::string& key, int32_t* width, int32_t* height);
+	void Add(const std::string& key, SDL_Texture* texture, const int32_t width, const int32_t height);
+	void SetBudget(const size_t bytes);
+	void Clear();
+
+	inline bool Contains(const std::string& key) const { return entriesByKey.find(key) != entriesByKey.end(); }
+	inline const TextureCacheStats& GetStats() const { return stats; }
+
+private:
+	void EvictToBudget();
+};
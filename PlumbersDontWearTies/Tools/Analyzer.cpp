@@ -0,0 +1,630 @@
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include "Game.h"
+#include "SceneGraph.h"
+
+// The state of the game between scenes is the scene, whether it starts from
+// the beginning or from the decision, and the last scene with a decision,
+// which is where SCENEID_PREVDECISION goes back to.
+
+enum AnalyzerSegments
+{
+	ANALYZER_SEGMENT_SCENE = 0,
+	ANALYZER_SEGMENT_DECISION = 1,
+	ANALYZER_NUM_SEGMENTS = 2
+};
+
+constexpr int32_t ANALYZER_NO_TARGET = -1;
+
+// States are indexed in dense arrays, which grow with the square of the scenes
+constexpr int32_t ANALYZER_MAX_SCENES = 2048;
+
+struct AnalyzerEdge
+{
+	int32_t target; // state, or ANALYZER_NO_TARGET if the game ends
+	int32_t scoreDelta;
+	int32_t ending; // scene index * SCENE_MAX_ACTIONS + action, if the game ends
+};
+
+struct AnalyzerStats
+{
+	bool isReached;
+	bool hasInfinitePaths;
+	bool isMinUnbounded;
+	bool isMaxUnbounded;
+	uint64_t paths; // saturates at UINT64_MAX
+	int64_t minScore;
+	int64_t maxScore;
+};
+
+// Work queue of each thread. The owner takes the newest states, so it goes
+// deep while the states are still in its cache, and the other threads steal
+// the oldest ones, which usually lead to bigger unexplored parts.
+
+class WorkQueue
+{
+private:
+	std::mutex mutex;
+	std::deque<int32_t> states;
+
+public:
+	void Push(const int32_t state)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		states.push_back(state);
+	}
+
+	bool Pop(int32_t* state)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (states.empty()) return false;
+
+		*state = states.back();
+		states.pop_back();
+		return true;
+	}
+
+	bool Steal(int32_t* state)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (states.empty()) return false;
+
+		*state = states.front();
+		states.pop_front();
+		return true;
+	}
+};
+
+class Analyzer
+{
+private:
+	const SceneGraph* sceneGraph;
+	int32_t numScenes;
+	int32_t numStates;
+
+	std::vector<std::vector<AnalyzerEdge>> edges;
+	std::unique_ptr<std::atomic<bool>[]> isVisited;
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::atomic<int64_t> pendingStates;
+	std::atomic<uint64_t> steals;
+
+	std::vector<AnalyzerStats> stats;
+	std::vector<AnalyzerStats> endingStats;
+	std::vector<bool> canReachEnding;
+
+public:
+	Analyzer(const SceneGraph* sceneGraph)
+	{
+		Analyzer::sceneGraph = sceneGraph;
+		numScenes = sceneGraph->GetNumScenes();
+		numStates = numScenes * ANALYZER_NUM_SEGMENTS * numScenes;
+		pendingStates = 0;
+		steals = 0;
+	}
+
+	inline int32_t GetStateKey(const int32_t sceneIndex, const int32_t segment, const int32_t lastDecisionSceneIndex) const
+	{
+		return (sceneIndex * ANALYZER_NUM_SEGMENTS + segment) * numScenes + lastDecisionSceneIndex;
+	}
+
+	inline int32_t GetSceneIndex(const int32_t state) const { return state / numScenes / ANALYZER_NUM_SEGMENTS; }
+	inline int32_t GetSegment(const int32_t state) const { return state / numScenes % ANALYZER_NUM_SEGMENTS; }
+	inline int32_t GetLastDecisionSceneIndex(const int32_t state) const { return state % numScenes; }
+
+	void Explore(const int32_t numThreads)
+	{
+		// Every state is claimed by the first thread that reaches it,
+		// which is then the only one that writes its edges.
+
+		edges.assign(numStates, std::vector<AnalyzerEdge>());
+		isVisited.reset(new std::atomic<bool>[numStates]);
+		for (int32_t s = 0; s < numStates; s++) isVisited[s] = false;
+
+		queues.clear();
+		for (int32_t t = 0; t < numThreads; t++) queues.emplace_back(new WorkQueue());
+
+		int32_t startState = GetStateKey(GAME_START_SCENE_INDEX, ANALYZER_SEGMENT_SCENE, 0);
+		isVisited[startState] = true;
+		pendingStates = 1;
+		queues[0]->Push(startState);
+
+		std::vector<std::thread> threads;
+		for (int32_t t = 0; t < numThreads; t++)
+			threads.emplace_back(&Analyzer::WorkerLoop, this, t);
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	void Analyze()
+	{
+		PropagateScores();
+		FindDeadEnds();
+	}
+
+	void PrintReport(const double exploreMilliseconds, const int32_t numThreads)
+	{
+		int32_t startState = GetStateKey(GAME_START_SCENE_INDEX, ANALYZER_SEGMENT_SCENE, 0);
+
+		// Reachability
+
+		int32_t reachedStates = 0;
+		std::vector<bool> isSceneReached(numScenes, false);
+
+		for (int32_t s = 0; s < numStates; s++)
+		{
+			if (!stats[s].isReached) continue;
+
+			reachedStates++;
+			isSceneReached[GetSceneIndex(s)] = true;
+		}
+
+		printf("Explored %i states of %i in %.2f ms with %i threads (%" PRIu64 " steals).\n\n", reachedStates, numStates, exploreMilliseconds, numThreads, steals.load());
+
+		int32_t reachedScenes = static_cast<int32_t>(std::count(isSceneReached.begin(), isSceneReached.end(), true));
+		printf("Reachable scenes: %i of %i\n", reachedScenes, numScenes);
+
+		if (reachedScenes < numScenes)
+		{
+			printf("Unreachable scenes:");
+			for (int32_t s = 0; s < numScenes; s++)
+				if (!isSceneReached[s]) printf(" %s", sceneGraph->GetScene(s).name.c_str());
+			printf("\n");
+		}
+
+		// Endings
+
+		AnalyzerStats totalStats = {};
+
+		printf("\nEndings:\n");
+
+		for (size_t e = 0; e < endingStats.size(); e++)
+		{
+			const AnalyzerStats& ending = endingStats[e];
+			if (!ending.isReached) continue;
+
+			int32_t sceneIndex = static_cast<int32_t>(e) / SCENE_MAX_ACTIONS;
+			int32_t action = static_cast<int32_t>(e) % SCENE_MAX_ACTIONS;
+
+			printf("  %-6s decision %i: %s paths, score %s\n", sceneGraph->GetScene(sceneIndex).name.c_str(), action + 1, FormatPaths(ending).c_str(), FormatScores(ending).c_str());
+			Merge(&totalStats, ending, 0);
+		}
+
+		if (!totalStats.isReached) printf("  None, the game can't be finished.\n");
+		else printf("\nTotal: %s paths, score %s\n", FormatPaths(totalStats).c_str(), FormatScores(totalStats).c_str());
+
+		// Places where the game can't be finished anymore
+
+		std::vector<bool> isDeadEndScene(numScenes, false);
+		int32_t deadEndStates = 0;
+
+		for (int32_t s = 0; s < numStates; s++)
+		{
+			if (!stats[s].isReached || canReachEnding[s]) continue;
+
+			deadEndStates++;
+			isDeadEndScene[GetSceneIndex(s)] = true;
+		}
+
+		if (deadEndStates > 0)
+		{
+			printf("\nDead ends (%i states, the game can't be finished from them):", deadEndStates);
+			for (int32_t s = 0; s < numScenes; s++)
+				if (isDeadEndScene[s]) printf(" %s", sceneGraph->GetScene(s).name.c_str());
+			printf("\n");
+		}
+
+		if (!canReachEnding[startState]) printf("\nThe game can't be finished from the start.\n");
+	}
+
+private:
+	void WorkerLoop(const int32_t threadIndex)
+	{
+		int32_t numThreads = static_cast<int32_t>(queues.size());
+
+		while (pendingStates.load() > 0)
+		{
+			int32_t state;
+			bool hasState = queues[threadIndex]->Pop(&state);
+
+			for (int32_t t = 1; !hasState && t < numThreads; t++)
+			{
+				hasState = queues[(threadIndex + t) % numThreads]->Steal(&state);
+				if (hasState) steals++;
+			}
+
+			if (!hasState)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			ExploreState(state, threadIndex);
+
+			// Only after its successors have been queued,
+			// so the count can't drop to 0 too early.
+			pendingStates--;
+		}
+	}
+
+	void ExploreState(const int32_t state, const int32_t threadIndex)
+	{
+		int32_t sceneIndex = GetSceneIndex(state);
+		int32_t lastDecisionSceneIndex = GetLastDecisionSceneIndex(state);
+		const SceneNode& scene = sceneGraph->GetScene(sceneIndex);
+		std::vector<AnalyzerEdge>* stateEdges = &edges[state];
+
+		if (GetSegment(state) == ANALYZER_SEGMENT_SCENE)
+		{
+			// After the pictures the decision always comes
+
+			AddEdge(stateEdges, GetStateKey(sceneIndex, ANALYZER_SEGMENT_DECISION, lastDecisionSceneIndex), 0, threadIndex);
+			return;
+		}
+
+		// Same as Game: a single action is taken without asking and doesn't
+		// change the score, and only real decisions are remembered as the
+		// last decision. With no actions at all the game waits forever.
+
+		for (int16_t a = 0; a < scene.numActions; a++)
+		{
+			const ActionNode& action = scene.actions[a];
+			int32_t scoreDelta = scene.numActions == 1 ? 0 : action.scoreDelta;
+			int32_t nextLastDecisionSceneIndex = scene.numActions > 1 ? sceneIndex : lastDecisionSceneIndex;
+
+			if (action.nextSceneIndex == SCENE_INDEX_ENDGAME)
+			{
+				AnalyzerEdge edge;
+				edge.target = ANALYZER_NO_TARGET;
+				edge.scoreDelta = scoreDelta;
+				edge.ending = sceneIndex * SCENE_MAX_ACTIONS + a;
+				stateEdges->push_back(edge);
+			}
+			else if (action.nextSceneIndex == SCENE_INDEX_PREVDECISION)
+			{
+				AddEdge(stateEdges, GetStateKey(lastDecisionSceneIndex, ANALYZER_SEGMENT_DECISION, nextLastDecisionSceneIndex), scoreDelta, threadIndex);
+			}
+			else
+			{
+				int32_t segment = action.sceneSegment == SEGMENT_DECISION ? ANALYZER_SEGMENT_DECISION : ANALYZER_SEGMENT_SCENE;
+				AddEdge(stateEdges, GetStateKey(action.nextSceneIndex, segment, nextLastDecisionSceneIndex), scoreDelta, threadIndex);
+			}
+		}
+	}
+
+	void AddEdge(std::vector<AnalyzerEdge>* stateEdges, const int32_t target, const int32_t scoreDelta, const int32_t threadIndex)
+	{
+		AnalyzerEdge edge;
+		edge.target = target;
+		edge.scoreDelta = scoreDelta;
+		edge.ending = -1;
+		stateEdges->push_back(edge);
+
+		if (isVisited[target].exchange(true)) return;
+
+		pendingStates++;
+		queues[threadIndex]->Push(target);
+	}
+
+	void PropagateScores()
+	{
+		// Strongly connected components, found in reverse topological order
+
+		std::vector<std::vector<int32_t>> components;
+		FindComponents(&components);
+
+		std::vector<int32_t> componentOf(numStates, -1);
+		for (size_t c = 0; c < components.size(); c++)
+			for (int32_t state : components[c]) componentOf[state] = static_cast<int32_t>(c);
+
+		stats.assign(numStates, AnalyzerStats());
+		endingStats.assign(numScenes * SCENE_MAX_ACTIONS, AnalyzerStats());
+
+		int32_t startState = GetStateKey(GAME_START_SCENE_INDEX, ANALYZER_SEGMENT_SCENE, 0);
+		stats[startState].isReached = true;
+		stats[startState].paths = 1;
+
+		// Walk them from the start, so every state is complete before it is
+		// propagated. The result of each state is the memoized value for all
+		// the paths that reach it.
+
+		for (size_t c = components.size(); c-- > 0;)
+		{
+			const std::vector<int32_t>& component = components[c];
+
+			if (IsCyclic(component)) ResolveCycle(component, componentOf);
+
+			for (int32_t state : component)
+			{
+				if (!stats[state].isReached) continue;
+
+				for (const AnalyzerEdge& edge : edges[state])
+				{
+					if (edge.target == ANALYZER_NO_TARGET)
+						Merge(&endingStats[edge.ending], stats[state], edge.scoreDelta);
+					else if (componentOf[edge.target] != static_cast<int32_t>(c))
+						Merge(&stats[edge.target], stats[state], edge.scoreDelta);
+				}
+			}
+		}
+	}
+
+	void ResolveCycle(const std::vector<int32_t>& component, const std::vector<int32_t>& componentOf)
+	{
+		// The states of a cycle can be visited any number of times. Find the
+		// score bounds with Bellman-Ford: if they still change after as many
+		// rounds as states, there is a cycle that keeps changing the score.
+
+		bool isReached = false;
+		for (int32_t state : component) isReached |= stats[state].isReached;
+		if (!isReached) return;
+
+		int32_t componentIndex = componentOf[component[0]];
+
+		for (int32_t pass = 0; pass < 2; pass++)
+		{
+			bool isMin = pass == 0;
+			bool hasChanged = true;
+
+			for (size_t round = 0; round <= component.size() && hasChanged; round++)
+			{
+				hasChanged = false;
+
+				for (int32_t state : component)
+				{
+					if (!stats[state].isReached) continue;
+
+					for (const AnalyzerEdge& edge : edges[state])
+					{
+						if (edge.target == ANALYZER_NO_TARGET || componentOf[edge.target] != componentIndex) continue;
+
+						AnalyzerStats* target = &stats[edge.target];
+						int64_t score = (isMin ? stats[state].minScore : stats[state].maxScore) + edge.scoreDelta;
+
+						if (!target->isReached)
+						{
+							target->isReached = true;
+							target->minScore = score;
+							target->maxScore = score;
+							hasChanged = true;
+						}
+						else if (isMin ? score < target->minScore : score > target->maxScore)
+						{
+							(isMin ? target->minScore : target->maxScore) = score;
+							hasChanged = true;
+						}
+					}
+				}
+			}
+
+			for (int32_t state : component)
+			{
+				if (isMin) stats[state].isMinUnbounded |= hasChanged;
+				else stats[state].isMaxUnbounded |= hasChanged;
+			}
+		}
+
+		for (int32_t state : component)
+		{
+			stats[state].hasInfinitePaths = true;
+			stats[state].paths = UINT64_MAX;
+		}
+	}
+
+	bool IsCyclic(const std::vector<int32_t>& component)
+	{
+		if (component.size() > 1) return true;
+
+		for (const AnalyzerEdge& edge : edges[component[0]])
+			if (edge.target == component[0]) return true;
+
+		return false;
+	}
+
+	void FindComponents(std::vector<std::vector<int32_t>>* components)
+	{
+		// Iterative Tarjan, only over the explored states
+
+		std::vector<int32_t> indices(numStates, -1);
+		std::vector<int32_t> lowLinks(numStates, 0);
+		std::vector<bool> isOnStack(numStates, false);
+		std::vector<int32_t> stack;
+		std::vector<std::pair<int32_t, size_t>> callStack;
+		int32_t nextIndex = 0;
+
+		for (int32_t root = 0; root < numStates; root++)
+		{
+			if (!isVisited[root] || indices[root] >= 0) continue;
+
+			callStack.push_back(std::make_pair(root, 0));
+
+			while (!callStack.empty())
+			{
+				int32_t state = callStack.back().first;
+				size_t edgeIndex = callStack.back().second;
+
+				if (edgeIndex == 0)
+				{
+					indices[state] = lowLinks[state] = nextIndex++;
+					stack.push_back(state);
+					isOnStack[state] = true;
+				}
+
+				bool hasDescended = false;
+
+				for (; edgeIndex < edges[state].size(); edgeIndex++)
+				{
+					int32_t target = edges[state][edgeIndex].target;
+					if (target == ANALYZER_NO_TARGET) continue;
+
+					if (indices[target] < 0)
+					{
+						callStack.back().second = edgeIndex + 1;
+						callStack.push_back(std::make_pair(target, 0));
+						hasDescended = true;
+						break;
+					}
+
+					if (isOnStack[target]) lowLinks[state] = std::min(lowLinks[state], indices[target]);
+				}
+
+				if (hasDescended) continue;
+
+				if (lowLinks[state] == indices[state])
+				{
+					std::vector<int32_t> component;
+					int32_t member;
+
+					do
+					{
+						member = stack.back();
+						stack.pop_back();
+						isOnStack[member] = false;
+						component.push_back(member);
+					}
+					while (member != state);
+
+					components->push_back(component);
+				}
+
+				callStack.pop_back();
+				if (!callStack.empty()) lowLinks[callStack.back().first] = std::min(lowLinks[callStack.back().first], lowLinks[state]);
+			}
+		}
+	}
+
+	void FindDeadEnds()
+	{
+		// Walk the edges backwards from the states that can end the game
+
+		std::vector<std::vector<int32_t>> predecessors(numStates);
+		std::vector<int32_t> pending;
+		canReachEnding.assign(numStates, false);
+
+		for (int32_t s = 0; s < numStates; s++)
+		{
+			for (const AnalyzerEdge& edge : edges[s])
+			{
+				if (edge.target != ANALYZER_NO_TARGET) predecessors[edge.target].push_back(s);
+				else if (!canReachEnding[s])
+				{
+					canReachEnding[s] = true;
+					pending.push_back(s);
+				}
+			}
+		}
+
+		while (!pending.empty())
+		{
+			int32_t state = pending.back();
+			pending.pop_back();
+
+			for (int32_t predecessor : predecessors[state])
+			{
+				if (canReachEnding[predecessor]) continue;
+
+				canReachEnding[predecessor] = true;
+				pending.push_back(predecessor);
+			}
+		}
+	}
+
+	static void Merge(AnalyzerStats* target, const AnalyzerStats& source, const int32_t scoreDelta)
+	{
+		if (!source.isReached) return;
+
+		int64_t minScore = source.minScore + scoreDelta;
+		int64_t maxScore = source.maxScore + scoreDelta;
+
+		if (!target->isReached)
+		{
+			*target = source;
+			target->minScore = minScore;
+			target->maxScore = maxScore;
+			return;
+		}
+
+		target->paths = target->paths > UINT64_MAX - source.paths ? UINT64_MAX : target->paths + source.paths;
+		target->hasInfinitePaths |= source.hasInfinitePaths;
+		target->isMinUnbounded |= source.isMinUnbounded;
+		target->isMaxUnbounded |= source.isMaxUnbounded;
+		target->minScore = std::min(target->minScore, minScore);
+		target->maxScore = std::max(target->maxScore, maxScore);
+	}
+
+	static std::string FormatPaths(const AnalyzerStats& stats)
+	{
+		if (stats.hasInfinitePaths) return "infinite";
+		if (stats.paths == UINT64_MAX) return "more than " + std::to_string(UINT64_MAX);
+		return std::to_string(stats.paths);
+	}
+
+	static std::string FormatScores(const AnalyzerStats& stats)
+	{
+		std::string minScore = stats.isMinUnbounded ? "-infinite" : std::to_string(stats.minScore);
+		std::string maxScore = stats.isMaxUnbounded ? "infinite" : std::to_string(stats.maxScore);
+		return minScore + " to " + maxScore;
+	}
+};
+
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <data folder> [--threads <n>]\n", args[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string baseDataPath = args[1];
+	if (baseDataPath.back() != '/' && baseDataPath.back() != '\\') baseDataPath += '/';
+
+	int32_t numThreads = static_cast<int32_t>(std::thread::hardware_concurrency());
+
+	for (int a = 2; a < argc; a++)
+	{
+		std::string argument = args[a];
+
+		if (argument == "--threads" && a + 1 < argc)
+			numThreads = atoi(args[++a]);
+	}
+
+	if (numThreads < 1) numThreads = 1;
+
+	SceneGraph sceneGraph;
+	if (!sceneGraph.Load(baseDataPath)) return EXIT_FAILURE;
+
+	if (sceneGraph.GetNumScenes() <= GAME_START_SCENE_INDEX)
+	{
+		printf("GAME.BIN doesn't have the start scene.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (sceneGraph.GetNumScenes() > ANALYZER_MAX_SCENES)
+	{
+		printf("GAME.BIN has %i scenes, only up to %i can be analyzed.\n", sceneGraph.GetNumScenes(), ANALYZER_MAX_SCENES);
+		return EXIT_FAILURE;
+	}
+
+	Analyzer analyzer(&sceneGraph);
+
+	Uint64 startTime = SDL_GetPerformanceCounter();
+	analyzer.Explore(numThreads);
+	double exploreMilliseconds = (SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	analyzer.Analyze();
+	analyzer.PrintReport(exploreMilliseconds, numThreads);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <string>
+
+#include <SDL.h>
+
+#include "BitmapDecoder.h"
+
+constexpr int32_t BENCHMARK_ITERATIONS = 50;
+constexpr uint32_t BENCHMARK_PIXEL_FORMAT = SDL_PIXELFORMAT_ARGB8888;
+
+static double GetMilliseconds(const Uint64 startTime, const Uint64 endTime)
+{
+	return (endTime - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+static double BenchmarkSDLDecode(const std::string& filePath)
+{
+	// SDL_LoadBMP followed by the conversion SDL_CreateTextureFromSurface does
+
+	Uint64 startTime = SDL_GetPerformanceCounter();
+
+	for (int32_t i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		SDL_Surface* surface = SDL_LoadBMP(filePath.c_str());
+		if (surface == nullptr) return -1.0;
+
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, BENCHMARK_PIXEL_FORMAT, 0);
+		SDL_FreeSurface(surface);
+		if (converted == nullptr) return -1.0;
+
+		SDL_FreeSurface(converted);
+	}
+
+	return GetMilliseconds(startTime, SDL_GetPerformanceCounter()) / BENCHMARK_ITERATIONS;
+}
+
+static double BenchmarkBitmapDecoder(const std::string& filePath)
+{
+	Uint64 startTime = SDL_GetPerformanceCounter();
+
+	for (int32_t i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		SDL_Surface* surface = BitmapDecoder::Load(filePath, BENCHMARK_PIXEL_FORMAT);
+		if (surface == nullptr) return -1.0;
+
+		SDL_FreeSurface(surface);
+	}
+
+	return GetMilliseconds(startTime, SDL_GetPerformanceCounter()) / BENCHMARK_ITERATIONS;
+}
+
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <file.bmp> [file.bmp...]\n", args[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-40s %12s %12s %8s\n", "Picture", "SDL (ms)", "Decoder (ms)", "Speedup");
+
+	for (int a = 1; a < argc; a++)
+	{
+		double sdlTime = BenchmarkSDLDecode(args[a]);
+		double decoderTime = BenchmarkBitmapDecoder(args[a]);
+
+		if (sdlTime < 0 || decoderTime < 0)
+		{
+			printf("%-40s could not be decoded: %s\n", args[a], SDL_GetError());
+			continue;
+		}
+
+		printf("%-40s %12.3f %12.3f %7.2fx\n", args[a], sdlTime, decoderTime, sdlTime / decoderTime);
+	}
+
+	return EXIT_SUCCESS;
+}
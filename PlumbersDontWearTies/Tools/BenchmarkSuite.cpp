@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+#include "AssetArchive.h"
+#include "Audio.h"
+#include "BitmapDecoder.h"
+#include "Config.h"
+#include "Game.h"
+#include "PicturePrefetcher.h"
+#include "Renderer.h"
+#include "SceneGraph.h"
+#include "Simulation.h"
+#include "SoftwareScaler.h"
+
+constexpr int32_t SUITE_PICTURE_ITERATIONS = 200;
+constexpr int32_t SUITE_LOOKUP_ITERATIONS = 200;
+constexpr int32_t SUITE_LOOKUPS_PER_ITERATION = 10000;
+constexpr int32_t SUITE_AUDIO_ITERATIONS = 256; // buffers of each WAV, must fit in the file
+constexpr int32_t SUITE_AUDIO_FILES = 8;
+constexpr int32_t SUITE_TEXT_ITERATIONS = 500;
+constexpr int32_t SUITE_SCALING_ITERATIONS = 100;
+constexpr int32_t SUITE_TRANSITION_ITERATIONS = 50;
+constexpr uint64_t SUITE_TRANSITIONS_PER_ITERATION = 200;
+constexpr int32_t SUITE_AUDIO_START_TIMEOUT = 2000; // milliseconds
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::string unit;
+	uint64_t operations;
+	std::vector<double> samples; // nanoseconds per operation, one for each iteration
+};
+
+static void PrintUsage(const char* programName)
+{
+	printf("Usage: %s <data folder> [options]\n", programName);
+	printf("  --font <file.ttf>   Font used for the score text (Font.ttf in the data folder by default)\n");
+	printf("  --output <file>     Write the JSON results to this file instead of the standard output\n");
+}
+
+static double GetNanoseconds(const Uint64 startTime, const Uint64 endTime)
+{
+	return (endTime - startTime) * 1000000000.0 / SDL_GetPerformanceFrequency();
+}
+
+static void AddSample(BenchmarkResult* result, const Uint64 startTime, const uint64_t operations)
+{
+	if (operations == 0) return;
+
+	result->samples.push_back(GetNanoseconds(startTime, SDL_GetPerformanceCounter()) / operations);
+	result->operations += operations;
+}
+
+static void BenchmarkLoadPicture(const SceneGraph& sceneGraph, const std::string& baseDataPath, const bool isCached, const bool isStreaming, BenchmarkResult* result)
+{
+	// Decode and upload, cycling through every picture of the first scenes.
+	// Without cache budget every picture is decoded again. Streaming textures
+	// don't use the cache, they measure the same switch as the first entry.
+
+	std::vector<std::string> fileNames;
+
+	for (int32_t s = 0; s < sceneGraph.GetNumScenes() && static_cast<int32_t>(fileNames.size()) < SUITE_PICTURE_ITERATIONS; s++)
+	{
+		const SceneNode& scene = sceneGraph.GetScene(s);
+
+		for (int32_t p = 0; p < scene.numPics; p++)
+			fileNames.push_back(sceneGraph.GetPicture(scene, p).bitmap.fileName);
+	}
+
+	if (fileNames.empty()) return;
+	if (isCached) fileNames.resize(std::min<size_t>(fileNames.size(), 4));
+
+	Renderer::SetTextureCacheBudget(isCached ? TEXTURE_CACHE_DEFAULT_BUDGET : 0);
+	Renderer::SetStreamingTextures(isStreaming);
+
+	for (const std::string& fileName : fileNames)
+		Renderer::LoadPictureFromBMP(baseDataPath, fileName);
+
+	for (int32_t i = 0; i < SUITE_PICTURE_ITERATIONS; i++)
+	{
+		Uint64 startTime = SDL_GetPerformanceCounter();
+		if (!Renderer::LoadPictureFromBMP(baseDataPath, fileNames[i % fileNames.size()])) break;
+		AddSample(result, startTime, 1);
+	}
+
+	Renderer::SetTextureCacheBudget(TEXTURE_CACHE_DEFAULT_BUDGET);
+	Renderer::SetStreamingTextures(false);
+}
+
+static void BenchmarkSceneLookup(const SceneGraph& sceneGraph, BenchmarkResult* result)
+{
+	int32_t numScenes = sceneGraph.GetNumScenes();
+	int64_t checksum = 0;
+
+	for (int32_t i = 0; i < SUITE_LOOKUP_ITERATIONS; i++)
+	{
+		Uint64 startTime = SDL_GetPerformanceCounter();
+
+		for (int32_t l = 0; l < SUITE_LOOKUPS_PER_ITERATION; l++)
+			checksum += sceneGraph.GetSceneIndex((l * 7919 + i) % numScenes);
+
+		AddSample(result, startTime, SUITE_LOOKUPS_PER_ITERATION);
+	}
+
+	// Keeps the lookups from being optimized away
+	if (checksum < 0) printf("%lld\n", static_cast<long long>(checksum));
+}
+
+static void BenchmarkAudioCallback(const SceneGraph& sceneGraph, const std::string& baseDataPath, BenchmarkResult* result)
+{
+	// One buffer of the size the device asks for, filled from each dialog
+	// once it is playing, so the data comes from a real source.
+
+	std::vector<uint8_t> buffer(WAV_SAMPLES * WAV_CHANNELS * WAV_FORMAT_BYTES);
+
+	for (int32_t s = 0; s < sceneGraph.GetNumScenes() && s < SUITE_AUDIO_FILES; s++)
+	{
+		if (!Audio::LoadAudioFromWAV(baseDataPath, sceneGraph.GetScene(s).dialogWav.fileName)) continue;
+
+		double playbackTime;
+		Uint32 startTicks = SDL_GetTicks();
+
+		while (!Audio::GetAudioPlaybackTime(&playbackTime) && SDL_GetTicks() - startTicks < SUITE_AUDIO_START_TIMEOUT)
+			SDL_Delay(1);
+
+		for (int32_t i = 0; i < SUITE_AUDIO_ITERATIONS; i++)
+		{
+			Uint64 startTime = SDL_GetPerformanceCounter();
+			Audio::FillBuffer(buffer.data(), static_cast<int32_t>(buffer.size()));
+			AddSample(result, startTime, 1);
+		}
+	}
+
+	Audio::StopAudio();
+}
+
+static void BenchmarkScoreText(BenchmarkResult* result)
+{
+	for (int32_t i = 0; i < SUITE_TEXT_ITERATIONS; i++)
+	{
+		Uint64 startTime = SDL_GetPerformanceCounter();
+		if (!Renderer::GenerateScoreText("Your score is: " + std::to_string(i * 10))) return;
+		AddSample(result, startTime, 1);
+	}
+
+	Renderer::GenerateScoreText(std::string());
+}
+
+static void BenchmarkSoftwareScaling(const SceneGraph& sceneGraph, const int32_t targetWidth, const int32_t targetHeight, BenchmarkResult* result)
+{
+	// The first picture scaled to a window size, the work done once per picture without a GPU
+
+	if (sceneGraph.GetNumScenes() == 0 || sceneGraph.GetScene(0).numPics == 0) return;
+
+	SDL_Surface* surface = BitmapDecoder::Load(sceneGraph.GetPicture(sceneGraph.GetScene(0), 0).bitmap.filePath, SDL_PIXELFORMAT_ARGB8888);
+	if (surface == nullptr) return;
+
+	std::vector<uint32_t> pixels(static_cast<size_t>(targetWidth) * targetHeight);
+
+	for (int32_t i = 0; i < SUITE_SCALING_ITERATIONS; i++)
+	{
+		Uint64 startTime = SDL_GetPerformanceCounter();
+		SoftwareScaler::Scale(surface, reinterpret_cast<uint8_t*>(pixels.data()), targetWidth, targetHeight, targetWidth * sizeof(uint32_t), ScalingFilters::Bilinear);
+		AddSample(result, startTime, 1);
+	}
+
+	SDL_FreeSurface(surface);
+}
+
+static void BenchmarkSceneTransition(Game* game, BenchmarkResult* result)
+{
+	// Full updates skipping the waits: every picture is decoded by the
+	// prefetcher before the update that shows it ends, and every dialog is
+	// loaded, as in the game. The upload is left to the renderer benchmarks.
+
+	SimulationOptions options;
+	Simulation::SetDefaultOptions(&options);
+	options.skipPictures = true;
+	options.maxTransitions = SUITE_TRANSITIONS_PER_ITERATION;
+
+	for (int32_t i = 0; i < SUITE_TRANSITION_ITERATIONS; i++)
+	{
+		options.seed = static_cast<uint32_t>(i);
+
+		SimulationResult simulationResult;
+		Uint64 startTime = SDL_GetPerformanceCounter();
+		Simulation::Run(game, options, &simulationResult);
+		AddSample(result, startTime, simulationResult.transitions);
+	}
+}
+
+static void WriteResult(FILE* file, const BenchmarkResult& result, const bool isLast)
+{
+	std::vector<double> samples = result.samples;
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (double sample : samples) sum += sample;
+
+	size_t count = samples.size();
+
+	fprintf(file, "    {\n");
+	fprintf(file, "      \"name\": \"%s\",\n", result.name.c_str());
+	fprintf(file, "      \"unit\": \"%s\",\n", result.unit.c_str());
+	fprintf(file, "      \"iterations\": %zu,\n", count);
+	fprintf(file, "      \"operations\": %llu", static_cast<unsigned long long>(result.operations));
+
+	if (count > 0)
+	{
+		fprintf(file, ",\n");
+		fprintf(file, "      \"mean_ns\": %.1f,\n", sum / count);
+		fprintf(file, "      \"median_ns\": %.1f,\n", samples[count / 2]);
+		fprintf(file, "      \"p95_ns\": %.1f,\n", samples[std::min(count - 1, count * 95 / 100)]);
+		fprintf(file, "      \"min_ns\": %.1f,\n", samples.front());
+		fprintf(file, "      \"max_ns\": %.1f\n", samples.back());
+	}
+	else
+	{
+		fprintf(file, ",\n      \"skipped\": true\n");
+	}
+
+	fprintf(file, "    }%s\n", isLast ? "" : ",");
+}
+
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		PrintUsage(args[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string baseDataPath = args[1];
+	if (baseDataPath.back() != '/' && baseDataPath.back() != '\\') baseDataPath += '/';
+
+	std::string fontPath = baseDataPath + "Font.ttf";
+	std::string outputPath;
+
+	for (int a = 2; a < argc; a++)
+	{
+		std::string argument = args[a];
+
+		if (argument == "--font" && a + 1 < argc)
+			fontPath = args[++a];
+		else if (argument == "--output" && a + 1 < argc)
+			outputPath = args[++a];
+		else
+		{
+			PrintUsage(args[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Runs without display or sound card, unless other drivers
+	// are chosen in the environment. Setting the render driver also
+	// keeps the renderer from measuring and saving its own choice.
+
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	SDL_setenv("SDL_RENDER_DRIVER", "software", 0);
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN);
+
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0)
+	{
+		printf("Error initializing SDL: %s\n", SDL_GetError());
+		return EXIT_FAILURE;
+	}
+
+	AssetArchive::Initialize(baseDataPath);
+
+	SDL_Window* window = SDL_CreateWindow("Plumbers Don't Wear Ties - Benchmark", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, SDL_WINDOW_HIDDEN);
+	SceneGraph sceneGraph;
+
+	if (window == nullptr || !Renderer::Initialize(window, fontPath) || !Audio::Initialize() || !sceneGraph.Load(baseDataPath))
+	{
+		printf("Error initializing the benchmark: %s\n", SDL_GetError());
+
+		Audio::Dispose();
+		Renderer::Dispose();
+		if (window != nullptr) SDL_DestroyWindow(window);
+		AssetArchive::Dispose();
+		SDL_Quit();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<BenchmarkResult> results(9);
+	results[0].name = "Renderer::LoadPictureFromBMP";
+	results[0].unit = "picture";
+	results[1].name = "Renderer::LoadPictureFromBMP (cached)";
+	results[1].unit = "picture";
+	results[2].name = "SceneGraph::GetSceneIndex";
+	results[2].unit = "lookup";
+	results[3].name = "Audio::AudioCallback";
+	results[3].unit = "buffer";
+	results[4].name = "Renderer::GenerateScoreText";
+	results[4].unit = "text";
+	results[5].name = "Game::Update";
+	results[5].unit = "transition";
+	results[6].name = "SoftwareScaler::Scale (1280x960)";
+	results[6].unit = "picture";
+	results[7].name = "SoftwareScaler::Scale (1280x1024)";
+	results[7].unit = "picture";
+	results[8].name = "Renderer::LoadPictureFromBMP (streaming textures)";
+	results[8].unit = "picture";
+
+	for (BenchmarkResult& result : results) result.operations = 0;
+
+	BenchmarkLoadPicture(sceneGraph, baseDataPath, false, false, &results[0]);
+	BenchmarkLoadPicture(sceneGraph, baseDataPath, true, false, &results[1]);
+	BenchmarkLoadPicture(sceneGraph, baseDataPath, false, true, &results[8]);
+	BenchmarkSceneLookup(sceneGraph, &results[2]);
+	BenchmarkAudioCallback(sceneGraph, baseDataPath, &results[3]);
+	BenchmarkScoreText(&results[4]);
+	BenchmarkSoftwareScaling(sceneGraph, 1280, 960, &results[6]);
+	BenchmarkSoftwareScaling(sceneGraph, 1280, 1024, &results[7]);
+
+	PicturePrefetcher::Initialize(Renderer::GetNativeTextureFormat());
+
+	Game* game = new Game(baseDataPath);
+	if (game->IsInitialized()) BenchmarkSceneTransition(game, &results[5]);
+	delete game;
+
+	PicturePrefetcher::Dispose();
+
+	Audio::Dispose();
+	Renderer::Dispose();
+	SDL_DestroyWindow(window);
+	AssetArchive::Dispose();
+	SDL_Quit();
+
+	// JSON, one entry for each benchmark, so runs can be compared with a diff
+
+	FILE* file = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "w");
+
+	if (file == nullptr)
+	{
+		printf("Error writing %s\n", outputPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"version\": \"%s\",\n", PROJECT_VER);
+	fprintf(file, "  \"scenes\": %i,\n", sceneGraph.GetNumScenes());
+	fprintf(file, "  \"benchmarks\": [\n");
+
+	for (size_t r = 0; r < results.size(); r++)
+		WriteResult(file, results[r], r == results.size() - 1);
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	if (file != stdout) fclose(file);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,446 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "Audio.h"
+#include "GameDataLoader.h"
+#include "SceneGraph.h"
+
+constexpr int32_t GENERATOR_MAX_DIMENSION = 8192;
+constexpr int32_t GENERATOR_MAX_PICTURES = 99999; // "P%05d.BMP"
+constexpr int32_t GENERATOR_SCORE_MIN = -10;
+constexpr int32_t GENERATOR_SCORE_MAX = 20;
+
+struct GeneratorOptions
+{
+	int32_t numScenes;
+	int32_t numPics; // per scene
+	int32_t width;
+	int32_t height;
+	int32_t duration; // deciseconds per picture, on average
+	int32_t branching; // decisions per scene
+	uint32_t seed;
+	bool isExtended;
+	bool writeAssets;
+};
+
+static void PrintUsage(const char* programName)
+{
+	printf("Usage: %s <output folder> [options]\n", programName);
+	printf("  --scenes <n>       Number of scenes (100 by default)\n");
+	printf("  --pictures <n>     Pictures per scene (10 by default)\n");
+	printf("  --size <w>x<h>     Size of the pictures (640x480 by default)\n");
+	printf("  --duration <n>     Average duration of a picture in deciseconds (20 by default)\n");
+	printf("  --branching <n>    Decisions per scene, from 1 to %i (3 by default)\n", SCENE_MAX_ACTIONS);
+	printf("  --seed <n>         Seed of the random generator (1 by default)\n");
+	printf("  --extended         Use the extended format of GAME.BIN even if the original one is enough\n");
+	printf("  --no-assets        Only write GAME.BIN, without pictures and audio\n");
+}
+
+static void WriteUInt16(std::vector<uint8_t>* data, const uint16_t value)
+{
+	data->push_back(static_cast<uint8_t>(value));
+	data->push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static void WriteUInt32(std::vector<uint8_t>* data, const uint32_t value)
+{
+	WriteUInt16(data, static_cast<uint16_t>(value));
+	WriteUInt16(data, static_cast<uint16_t>(value >> 16));
+}
+
+static bool WriteFile(const std::string& filePath, const std::vector<uint8_t>& data)
+{
+	std::ofstream stream(filePath, std::ios::binary | std::ios::trunc);
+	if (!stream.is_open()) return false;
+
+	stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return stream.good();
+}
+
+static bool CreateFolder(const std::string& folderPath)
+{
+#ifdef _WIN32
+	int result = _mkdir(folderPath.c_str());
+#else
+	int result = mkdir(folderPath.c_str(), 0755);
+#endif
+
+	return result == 0 || errno == EEXIST;
+}
+
+static void SetString(char* text, const size_t maxLength, const char* value)
+{
+	memset(text, 0, maxLength);
+	strncpy(text, value, maxLength - 1);
+}
+
+static void GetHotspot(const GeneratorOptions& options, const int32_t numActions, const int32_t a, _coord* topLeft, _coord* bottomRight)
+{
+	// One horizontal band per decision, like the original decision pages
+
+	int32_t bandHeight = options.height / numActions;
+
+	topLeft->x = 0;
+	topLeft->y = static_cast<int16_t>(a * bandHeight);
+	bottomRight->x = static_cast<int16_t>(options.width - 1);
+	bottomRight->y = static_cast<int16_t>(a == numActions - 1 ? options.height - 1 : (a + 1) * bandHeight - 1);
+}
+
+static void GenerateScenes(const GeneratorOptions& options, GameDefinition* definition)
+{
+	std::mt19937 random(options.seed);
+
+	definition->scenes.resize(options.numScenes);
+	definition->pictures.resize(static_cast<size_t>(options.numScenes) * options.numPics);
+
+	for (int32_t s = 0; s < options.numScenes; s++)
+	{
+		_sceneDefEx* scene = &definition->scenes[s];
+		memset(scene, 0, sizeof(_sceneDefEx));
+
+		char sceneFolder[16];
+		snprintf(sceneFolder, sizeof(sceneFolder), "SC%02d", s);
+
+		SetString(scene->szSceneFolder, sizeof(scene->szSceneFolder), sceneFolder);
+		SetString(scene->szDialogWav, sizeof(scene->szDialogWav), "DIALOG.WAV");
+		SetString(scene->szDecisionBmp, sizeof(scene->szDecisionBmp), "DECISION.BMP");
+
+		scene->numPics = options.numPics;
+		scene->pictureIndex = s * options.numPics;
+
+		for (int32_t p = 0; p < options.numPics; p++)
+		{
+			_pictureDef* picture = &definition->pictures[scene->pictureIndex + p];
+
+			char fileName[16];
+			snprintf(fileName, sizeof(fileName), "P%05d.BMP", p + 1);
+			SetString(picture->szBitmapFile, sizeof(picture->szBitmapFile), fileName);
+
+			std::uniform_int_distribution<int32_t> duration((options.duration + 1) / 2, options.duration * 3 / 2);
+			picture->duration = static_cast<int16_t>(duration(random));
+		}
+
+		// The first action keeps every scene reachable, the others jump
+		// ahead, sometimes straight to a decision or back to the last one
+
+		bool isLastScene = s == options.numScenes - 1;
+		scene->numActions = isLastScene ? 1 : options.branching;
+
+		for (int32_t a = 0; a < scene->numActions; a++)
+		{
+			_actionDefEx* action = &scene->actions[a];
+
+			std::uniform_int_distribution<int32_t> score(GENERATOR_SCORE_MIN, GENERATOR_SCORE_MAX);
+			action->scoreDelta = score(random);
+			action->sceneSegment = SEGMENT_BEGINNING;
+
+			if (isLastScene)
+				action->nextSceneID = SCENEID_EX_ENDGAME;
+			else if (a == 0)
+				action->nextSceneID = s + 1;
+			else if (random() % 8 == 0 && s > 1)
+				action->nextSceneID = SCENEID_PREVDECISION;
+			else
+			{
+				std::uniform_int_distribution<int32_t> jump(2, options.branching * 4);
+				int32_t nextSceneID = s + jump(random);
+
+				action->nextSceneID = nextSceneID < options.numScenes ? nextSceneID : SCENEID_EX_ENDGAME;
+				if (nextSceneID < options.numScenes && random() % 8 == 0) action->sceneSegment = SEGMENT_DECISION;
+			}
+
+			GetHotspot(options, scene->numActions, a, &action->cHotspotTopLeft, &action->cHotspotBottomRigh);
+		}
+	}
+}
+
+static void CreatePalette(const int32_t sceneIndex, std::vector<uint8_t>* palette)
+{
+	// A ramp of a different colour for each scene, stored as BGRA
+
+	uint8_t red = static_cast<uint8_t>(64 + (sceneIndex * 37) % 192);
+	uint8_t green = static_cast<uint8_t>(64 + (sceneIndex * 73) % 192);
+	uint8_t blue = static_cast<uint8_t>(64 + (sceneIndex * 151) % 192);
+
+	palette->resize(256 * 4);
+
+	for (int32_t c = 0; c < 256; c++)
+	{
+		(*palette)[c * 4 + 0] = static_cast<uint8_t>(blue * c / 255);
+		(*palette)[c * 4 + 1] = static_cast<uint8_t>(green * c / 255);
+		(*palette)[c * 4 + 2] = static_cast<uint8_t>(red * c / 255);
+		(*palette)[c * 4 + 3] = 0;
+	}
+}
+
+static void CreatePicture(const GeneratorOptions& options, const std::vector<uint8_t>& palette, const int32_t sceneIndex, const int32_t pictureIndex, std::vector<uint8_t>* data)
+{
+	// 8 bit uncompressed BMP, like the ones of the original game. The
+	// background changes every few pictures and a block moves between
+	// them, so most consecutive pictures only differ in a small area.
+
+	int32_t stride = (options.width + 3) & ~3;
+	uint32_t pixelsOffset = 14 + 40 + static_cast<uint32_t>(palette.size());
+	uint32_t fileSize = pixelsOffset + stride * options.height;
+
+	data->clear();
+	data->reserve(fileSize);
+
+	data->push_back('B');
+	data->push_back('M');
+	WriteUInt32(data, fileSize);
+	WriteUInt32(data, 0);
+	WriteUInt32(data, pixelsOffset);
+
+	WriteUInt32(data, 40);
+	WriteUInt32(data, static_cast<uint32_t>(options.width));
+	WriteUInt32(data, static_cast<uint32_t>(options.height));
+	WriteUInt16(data, 1);
+	WriteUInt16(data, 8);
+	WriteUInt32(data, 0); // BI_RGB
+	WriteUInt32(data, static_cast<uint32_t>(stride * options.height));
+	WriteUInt32(data, 2835);
+	WriteUInt32(data, 2835);
+	WriteUInt32(data, 256);
+	WriteUInt32(data, 0);
+
+	data->insert(data->end(), palette.begin(), palette.end());
+
+	int32_t background = pictureIndex < 0 ? 0 : pictureIndex / 4;
+	int32_t blockSize = options.width < options.height ? options.width / 8 : options.height / 8;
+	int32_t blockX = 0, blockY = 0;
+
+	if (pictureIndex >= 0 && blockSize > 0)
+	{
+		blockX = (pictureIndex * blockSize) % (options.width - blockSize + 1);
+		blockY = ((pictureIndex * blockSize) / (options.width - blockSize + 1) * blockSize) % (options.height - blockSize + 1);
+	}
+
+	data->resize(fileSize, 0);
+	uint8_t* pixels = data->data() + pixelsOffset;
+
+	for (int32_t y = 0; y < options.height; y++)
+	{
+		// Rows are stored bottom-up
+
+		uint8_t* row = pixels + (options.height - 1 - y) * stride;
+
+		for (int32_t x = 0; x < options.width; x++)
+		{
+			uint8_t color;
+
+			if (pictureIndex < 0)
+				color = static_cast<uint8_t>(64 + 64 * (y * SCENE_MAX_ACTIONS / options.height) + ((x / 16 + y / 16) & 1) * 32);
+			else if (x >= blockX && x < blockX + blockSize && y >= blockY && y < blockY + blockSize)
+				color = 255;
+			else
+				color = static_cast<uint8_t>(((x + background * 7) ^ (y + sceneIndex * 13)) & 0xBF);
+
+			row[x] = color;
+		}
+	}
+}
+
+static void CreateWav(const int32_t sceneIndex, const uint32_t durationDeciseconds, std::vector<uint8_t>* data)
+{
+	// A tone of a different pitch for each scene, as long as its pictures
+
+	uint32_t numFrames = static_cast<uint32_t>(static_cast<uint64_t>(durationDeciseconds) * WAV_FREQUENCY / 10);
+	uint32_t dataSize = numFrames * WAV_CHANNELS * WAV_FORMAT_BYTES;
+
+	data->clear();
+	data->reserve(44 + dataSize);
+
+	data->insert(data->end(), { 'R', 'I', 'F', 'F' });
+	WriteUInt32(data, 36 + dataSize);
+	data->insert(data->end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+	WriteUInt32(data, 16);
+	WriteUInt16(data, 1); // PCM
+	WriteUInt16(data, WAV_CHANNELS);
+	WriteUInt32(data, WAV_FREQUENCY);
+	WriteUInt32(data, WAV_FREQUENCY * WAV_CHANNELS * WAV_FORMAT_BYTES);
+	WriteUInt16(data, WAV_CHANNELS * WAV_FORMAT_BYTES);
+	WriteUInt16(data, WAV_FORMAT_BYTES * 8);
+	data->insert(data->end(), { 'd', 'a', 't', 'a' });
+	WriteUInt32(data, dataSize);
+
+	double frequency = 220.0 + (sceneIndex % 12) * 55.0;
+	double step = 2.0 * 3.14159265358979323846 * frequency / WAV_FREQUENCY;
+
+	for (uint32_t f = 0; f < numFrames; f++)
+	{
+		int16_t sample = static_cast<int16_t>(sin(f * step) * 8000.0);
+
+		for (int32_t c = 0; c < WAV_CHANNELS; c++) WriteUInt16(data, static_cast<uint16_t>(sample));
+	}
+}
+
+static bool WriteAssets(const GeneratorOptions& options, const GameDefinition& definition, const std::string& baseDataPath, uint64_t* totalBytes)
+{
+	std::vector<uint8_t> palette, data;
+
+	for (int32_t s = 0; s < options.numScenes; s++)
+	{
+		const _sceneDefEx* scene = &definition.scenes[s];
+		std::string folderPath = baseDataPath + scene->szSceneFolder + "/";
+
+		if (!CreateFolder(folderPath))
+		{
+			printf("Error creating %s\n", folderPath.c_str());
+			return false;
+		}
+
+		CreatePalette(s, &palette);
+		uint32_t sceneDuration = 0;
+
+		for (int32_t p = 0; p < scene->numPics; p++)
+		{
+			const _pictureDef* picture = &definition.pictures[scene->pictureIndex + p];
+
+			CreatePicture(options, palette, s, p, &data);
+			if (!WriteFile(folderPath + picture->szBitmapFile, data)) return false;
+
+			sceneDuration += picture->duration;
+			*totalBytes += data.size();
+		}
+
+		CreatePicture(options, palette, s, -1, &data);
+		if (!WriteFile(folderPath + scene->szDecisionBmp, data)) return false;
+		*totalBytes += data.size();
+
+		CreateWav(s, sceneDuration, &data);
+		if (!WriteFile(folderPath + scene->szDialogWav, data)) return false;
+		*totalBytes += data.size();
+	}
+
+	return true;
+}
+
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		PrintUsage(args[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string baseDataPath = args[1];
+	if (baseDataPath.back() != '/' && baseDataPath.back() != '\\') baseDataPath += '/';
+
+	GeneratorOptions options;
+	options.numScenes = 100;
+	options.numPics = 10;
+	options.width = 640;
+	options.height = 480;
+	options.duration = 20;
+	options.branching = SCENE_MAX_ACTIONS;
+	options.seed = 1;
+	options.isExtended = false;
+	options.writeAssets = true;
+
+	for (int a = 2; a < argc; a++)
+	{
+		std::string argument = args[a];
+
+		if (argument == "--scenes" && a + 1 < argc)
+			options.numScenes = atoi(args[++a]);
+		else if (argument == "--pictures" && a + 1 < argc)
+			options.numPics = atoi(args[++a]);
+		else if (argument == "--size" && a + 1 < argc)
+		{
+			if (sscanf(args[++a], "%ix%i", &options.width, &options.height) != 2) options.width = 0;
+		}
+		else if (argument == "--duration" && a + 1 < argc)
+			options.duration = atoi(args[++a]);
+		else if (argument == "--branching" && a + 1 < argc)
+			options.branching = atoi(args[++a]);
+		else if (argument == "--seed" && a + 1 < argc)
+			options.seed = static_cast<uint32_t>(strtoul(args[++a], nullptr, 10));
+		else if (argument == "--extended")
+			options.isExtended = true;
+		else if (argument == "--no-assets")
+			options.writeAssets = false;
+		else
+		{
+			PrintUsage(args[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Scene 0 isn't played, the game starts with scene 1
+
+	if (options.numScenes < 2 || options.numPics < 1 || options.numPics > GENERATOR_MAX_PICTURES || options.branching < 1 || options.branching > SCENE_MAX_ACTIONS)
+	{
+		printf("There must be at least 2 scenes, 1 to %i pictures per scene and 1 to %i decisions per scene.\n", GENERATOR_MAX_PICTURES, SCENE_MAX_ACTIONS);
+		return EXIT_FAILURE;
+	}
+
+	if (options.width < SCENE_MAX_ACTIONS || options.width > GENERATOR_MAX_DIMENSION || options.height < SCENE_MAX_ACTIONS || options.height > GENERATOR_MAX_DIMENSION)
+	{
+		printf("The size of the pictures must be between %ix%i and %ix%i.\n", SCENE_MAX_ACTIONS, SCENE_MAX_ACTIONS, GENERATOR_MAX_DIMENSION, GENERATOR_MAX_DIMENSION);
+		return EXIT_FAILURE;
+	}
+
+	if (options.duration < 1 || options.duration > INT16_MAX * 2 / 3)
+	{
+		printf("The duration must be between 1 and %i deciseconds.\n", INT16_MAX * 2 / 3);
+		return EXIT_FAILURE;
+	}
+
+	if (static_cast<int64_t>(options.numScenes) * options.numPics > INT32_MAX)
+	{
+		printf("There can't be more than %i pictures in total.\n", INT32_MAX);
+		return EXIT_FAILURE;
+	}
+
+	if (!CreateFolder(baseDataPath))
+	{
+		printf("Error creating %s\n", baseDataPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	GameDefinition definition;
+	GenerateScenes(options, &definition);
+
+	// The original format is used whenever the game fits in it
+
+	std::vector<uint8_t> gameBin;
+	bool isExtended = options.isExtended || !GameDataLoader::SaveClassic(definition, &gameBin);
+	if (isExtended) GameDataLoader::SaveExtended(definition, &gameBin);
+
+	if (!WriteFile(baseDataPath + "GAME.BIN", gameBin))
+	{
+		printf("Error writing %sGAME.BIN\n", baseDataPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	printf("GAME.BIN (%s format): %i scenes, %zu pictures, %zu bytes\n", isExtended ? "extended" : "original", options.numScenes, definition.pictures.size(), gameBin.size());
+
+	if (options.writeAssets)
+	{
+		uint64_t totalBytes = 0;
+
+		if (!WriteAssets(options, definition, baseDataPath, &totalBytes))
+		{
+			printf("Error writing the pictures and audio of the scenes\n");
+			return EXIT_FAILURE;
+		}
+
+		printf("Assets: %zu pictures and %i sounds, %llu bytes\n", definition.pictures.size() + options.numScenes, options.numScenes, static_cast<unsigned long long>(totalBytes));
+	}
+
+	return EXIT_SUCCESS;
+}
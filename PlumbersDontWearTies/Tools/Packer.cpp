@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+#include "AssetArchive.h"
+#include "SceneGraph.h"
+
+static bool ReadFile(const std::string& filePath, std::vector<uint8_t>* data)
+{
+	std::ifstream stream(filePath, std::ios::binary | std::ios::ate);
+	if (!stream.is_open()) return false;
+
+	std::streamoff size = stream.tellg();
+	data->resize(static_cast<size_t>(size));
+
+	stream.seekg(0, std::ios_base::beg);
+	stream.read(reinterpret_cast<char*>(data->data()), size);
+
+	return stream.gcount() == size;
+}
+
+static void AddFileName(const AssetPath& assetPath, std::set<std::string>* fileNames)
+{
+	// Fields that are empty in GAME.BIN result in just the folder name
+
+	if (assetPath.fileName.empty() || assetPath.fileName.back() == '/') return;
+	fileNames->insert(assetPath.fileName);
+}
+
+static bool WritePadding(std::ofstream* stream, const uint64_t position)
+{
+	static const char zeros[ARCHIVE_ALIGNMENT] = {};
+
+	size_t padding = static_cast<size_t>((ARCHIVE_ALIGNMENT - position % ARCHIVE_ALIGNMENT) % ARCHIVE_ALIGNMENT);
+	stream->write(zeros, padding);
+
+	return stream->good();
+}
+
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <data folder> [archive file]\n", args[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string baseDataPath = args[1];
+	if (baseDataPath.back() != '/' && baseDataPath.back() != '\\') baseDataPath += '/';
+
+	std::string archivePath = argc > 2 ? args[2] : baseDataPath + ARCHIVE_FILE_NAME;
+
+	// Find every file referenced by GAME.BIN
+
+	SceneGraph sceneGraph;
+	if (!sceneGraph.Load(baseDataPath)) return EXIT_FAILURE;
+
+	std::set<std::string> fileNames;
+	fileNames.insert("GAME.BIN");
+
+	for (int32_t s = 0; s < sceneGraph.GetNumScenes(); s++)
+	{
+		const SceneNode& scene = sceneGraph.GetScene(s);
+
+		AddFileName(scene.dialogWav, &fileNames);
+		AddFileName(scene.decisionBmp, &fileNames);
+
+		for (int32_t p = 0; p < scene.numPics; p++)
+			AddFileName(sceneGraph.GetPicture(scene, p).bitmap, &fileNames);
+	}
+
+	// Build the index, sorted by name because the set already is.
+	// Files that don't exist are left out, the game will report them.
+
+	std::vector<ArchiveEntry> entries;
+	std::vector<std::string> filePaths;
+
+	uint64_t totalSize = 0;
+
+	for (const std::string& fileName : fileNames)
+	{
+		if (fileName.size() >= ARCHIVE_NAME_SIZE)
+		{
+			printf("Skipping %s, the name is too long.\n", fileName.c_str());
+			continue;
+		}
+
+		std::ifstream stream(baseDataPath + fileName, std::ios::binary | std::ios::ate);
+		if (!stream.is_open())
+		{
+			printf("Skipping %s, it has not been found.\n", fileName.c_str());
+			continue;
+		}
+
+		ArchiveEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		strcpy(entry.name, fileName.c_str());
+		entry.size = static_cast<uint64_t>(stream.tellg());
+
+		entries.push_back(entry);
+		filePaths.push_back(baseDataPath + fileName);
+		totalSize += entry.size;
+	}
+
+	uint64_t offset = sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry);
+
+	for (ArchiveEntry& entry : entries)
+	{
+		offset = (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+		entry.offset = offset;
+		offset += entry.size;
+	}
+
+	// Write the header, the index and then the files
+
+	std::ofstream archiveStream(archivePath, std::ios::binary | std::ios::trunc);
+	if (!archiveStream.is_open())
+	{
+		printf("Can't create %s\n", archivePath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	ArchiveHeader header;
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.numEntries = static_cast<uint32_t>(entries.size());
+	header.reserved = 0;
+
+	archiveStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	archiveStream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+
+	uint64_t position = sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry);
+	std::vector<uint8_t> fileData;
+
+	for (size_t e = 0; e < entries.size(); e++)
+	{
+		if (!ReadFile(filePaths[e], &fileData) || fileData.size() != entries[e].size)
+		{
+			printf("Can't read %s\n", filePaths[e].c_str());
+			return EXIT_FAILURE;
+		}
+
+		if (!WritePadding(&archiveStream, position))
+		{
+			printf("Can't write %s\n", archivePath.c_str());
+			return EXIT_FAILURE;
+		}
+
+		archiveStream.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+		position = entries[e].offset + entries[e].size;
+	}
+
+	archiveStream.close();
+
+	if (archiveStream.fail())
+	{
+		printf("Can't write %s\n", archivePath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	printf("Packed %u files (%.1f MB) into %s (%.1f MB).\n", header.numEntries, totalSize / (1024.0 * 1024.0), archivePath.c_str(), position / (1024.0 * 1024.0));
+
+	return EXIT_SUCCESS;
+}
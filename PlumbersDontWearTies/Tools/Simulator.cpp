@@ -0,0 +1,151 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <SDL.h>
+
+#include "AssetArchive.h"
+#include "Game.h"
+#include "Simulation.h"
+
+static void PrintUsage(const char* programName)
+{
+	printf("Usage: %s <data folder> [options]\n", programName);
+	printf("  --playthroughs <n>     Number of playthroughs (1 by default)\n");
+	printf("  --seed <n>             Seed of the first playthrough, the next ones use the following seeds\n");
+	printf("  --choices <1,2,...>    Decisions to take in order, random ones are taken after them\n");
+	printf("  --step <seconds>       Simulated time per update (%.2f by default)\n", SIMULATION_DEFAULT_TIME_STEP);
+	printf("  --skip-pictures        Skip every picture instead of waiting for it\n");
+	printf("  --max-transitions <n>  Stop a playthrough after this many transitions\n");
+	printf("  --verbose              Print the game log\n");
+}
+
+static void ParseChoices(const char* text, std::vector<int8_t>* choices)
+{
+	// Numbered from 1, like the keys used to choose them in the game
+
+	char* end;
+
+	while (*text != '\0')
+	{
+		long choice = strtol(text, &end, 10);
+		if (end == text) break;
+
+		choices->push_back(static_cast<int8_t>(choice - 1));
+
+		text = end;
+		if (*text == ',') text++;
+	}
+}
+
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		PrintUsage(args[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string baseDataPath = args[1];
+	if (baseDataPath.back() != '/' && baseDataPath.back() != '\\') baseDataPath += '/';
+
+	SimulationOptions options;
+	Simulation::SetDefaultOptions(&options);
+
+	uint32_t playthroughs = 1;
+	bool isVerbose = false;
+
+	for (int a = 2; a < argc; a++)
+	{
+		std::string argument = args[a];
+
+		if (argument == "--playthroughs" && a + 1 < argc)
+			playthroughs = static_cast<uint32_t>(strtoul(args[++a], nullptr, 10));
+		else if (argument == "--seed" && a + 1 < argc)
+			options.seed = static_cast<uint32_t>(strtoul(args[++a], nullptr, 10));
+		else if (argument == "--choices" && a + 1 < argc)
+			ParseChoices(args[++a], &options.choices);
+		else if (argument == "--step" && a + 1 < argc)
+			options.timeStep = atof(args[++a]);
+		else if (argument == "--skip-pictures")
+			options.skipPictures = true;
+		else if (argument == "--max-transitions" && a + 1 < argc)
+			options.maxTransitions = strtoull(args[++a], nullptr, 10);
+		else if (argument == "--verbose")
+			isVerbose = true;
+		else
+		{
+			PrintUsage(args[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (options.timeStep <= 0.0)
+	{
+		printf("The time step must be greater than 0.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Only problems are worth printing when running thousands of scenes
+
+	if (!isVerbose) SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN);
+
+	AssetArchive::Initialize(baseDataPath);
+
+	Game* game = new Game(baseDataPath);
+
+	if (!game->IsInitialized())
+	{
+		delete game;
+		AssetArchive::Dispose();
+		return EXIT_FAILURE;
+	}
+
+	uint64_t totalUpdates = 0, totalTransitions = 0, totalDecisions = 0, totalPreloadedDecisions = 0;
+	int64_t totalScore = 0;
+	double totalSimulatedTime = 0.0;
+	uint32_t endedPlaythroughs = 0;
+
+	Uint64 startTime = SDL_GetPerformanceCounter();
+
+	for (uint32_t p = 0; p < playthroughs; p++)
+	{
+		SimulationResult result;
+		Simulation::Run(game, options, &result);
+		options.seed++;
+
+		if (playthroughs == 1)
+		{
+			printf("Playthrough %s with score %i after %u decisions, %llu transitions and %.1f simulated seconds.\n",
+				result.hasEnded ? "ended" : "stopped", result.score, result.decisions, static_cast<unsigned long long>(result.transitions), result.simulatedTime);
+		}
+
+		totalUpdates += result.updates;
+		totalTransitions += result.transitions;
+		totalDecisions += result.decisions;
+		totalPreloadedDecisions += result.preloadedDecisions;
+		totalScore += result.score;
+		totalSimulatedTime += result.simulatedTime;
+		if (result.hasEnded) endedPlaythroughs++;
+	}
+
+	double elapsedSeconds = (SDL_GetPerformanceCounter() - startTime) / static_cast<double>(SDL_GetPerformanceFrequency());
+
+	delete game;
+	AssetArchive::Dispose();
+
+	printf("%u playthroughs (%u ended), %llu decisions, average score %.1f\n", playthroughs, endedPlaythroughs, static_cast<unsigned long long>(totalDecisions), playthroughs > 0 ? totalScore / static_cast<double>(playthroughs) : 0.0);
+	printf("%llu transitions and %llu updates in %.3f s: %.0f transitions/s, %.0f updates/s, %.0fx real time\n",
+		static_cast<unsigned long long>(totalTransitions), static_cast<unsigned long long>(totalUpdates), elapsedSeconds,
+		totalTransitions / elapsedSeconds, totalUpdates / elapsedSeconds, totalSimulatedTime / elapsedSeconds);
+
+	// The branches of every decision must be preloaded while the player thinks
+
+	if (totalPreloadedDecisions != totalDecisions)
+	{
+		printf("Only %llu of %llu decisions had their branches preloaded before the input.\n", static_cast<unsigned long long>(totalPreloadedDecisions), static_cast<unsigned long long>(totalDecisions));
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
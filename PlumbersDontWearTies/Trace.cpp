@@ -0,0 +1,179 @@
+#include "Trace.h"
+
+#include <cstdio>
+
+#include "Log.h"
+
+std::atomic<bool> Trace::isEnabled(false);
+std::atomic<uint32_t> Trace::session(0);
+std::mutex Trace::buffersMutex;
+std::vector<std::unique_ptr<Trace::ThreadBuffer>> Trace::buffers = std::vector<std::unique_ptr<Trace::ThreadBuffer>>();
+std::atomic<Trace::ThreadBuffer*> Trace::reservedBuffers[TRACE_RESERVED_BUFFERS] = {};
+std::string Trace::filePath = std::string();
+Uint64 Trace::startTime = 0;
+
+// Buffer of the current thread, only valid for the session it was created in
+
+thread_local Trace::ThreadBuffer* Trace::threadBuffer = nullptr;
+thread_local uint32_t Trace::threadBufferSession = 0;
+
+void Trace::Initialize(const std::string& filePath)
+{
+	if (IsEnabled()) return;
+
+	Trace::filePath = filePath;
+	startTime = SDL_GetPerformanceCounter();
+
+	session++;
+	isEnabled.store(true, std::memory_order_release);
+}
+
+void Trace::Dispose()
+{
+	if (!IsEnabled()) return;
+
+	isEnabled.store(false, std::memory_order_release);
+
+	Save();
+
+	for (std::atomic<ThreadBuffer*>& reservedBuffer : reservedBuffers)
+		reservedBuffer.store(nullptr);
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	buffers.clear();
+}
+
+void Trace::SetThreadName(const char* name)
+{
+	if (!IsEnabled()) return;
+
+	ThreadBuffer* buffer = GetThreadBuffer();
+	if (buffer->name.empty()) buffer->name = name;
+}
+
+uint32_t Trace::ReserveBuffer(const char* threadName)
+{
+	if (!IsEnabled()) return 0;
+
+	ThreadBuffer* buffer = CreateBuffer(threadName);
+
+	for (uint32_t r = 0; r < TRACE_RESERVED_BUFFERS; r++)
+	{
+		ThreadBuffer* expected = nullptr;
+		if (reservedBuffers[r].compare_exchange_strong(expected, buffer)) return r + 1;
+	}
+
+	// The buffer stays registered but unused, the thread will allocate its own
+
+	return 0;
+}
+
+void Trace::ClaimBuffer(const uint32_t reservation)
+{
+	if (reservation == 0 || !IsEnabled()) return;
+
+	uint32_t currentSession = session.load(std::memory_order_relaxed);
+	if (threadBuffer != nullptr && threadBufferSession == currentSession) return;
+
+	ThreadBuffer* buffer = reservedBuffers[reservation - 1].exchange(nullptr);
+	if (buffer == nullptr) return;
+
+	threadBuffer = buffer;
+	threadBufferSession = currentSession;
+}
+
+void Trace::AddZone(const char* name, const Uint64 startTime, const Uint64 endTime)
+{
+	if (!IsEnabled()) return;
+
+	ThreadBuffer* buffer = GetThreadBuffer();
+
+	if (buffer->count >= TRACE_EVENTS_PER_THREAD)
+	{
+		buffer->dropped++;
+		return;
+	}
+
+	TraceEvent* event = &buffer->events[buffer->count++];
+	event->name = name;
+	event->startTime = startTime;
+	event->endTime = endTime;
+}
+
+Trace::ThreadBuffer* Trace::GetThreadBuffer()
+{
+	uint32_t currentSession = session.load(std::memory_order_relaxed);
+
+	if (threadBuffer != nullptr && threadBufferSession == currentSession) return threadBuffer;
+
+	// First zone of this thread, the only time a lock is taken
+
+	threadBuffer = CreateBuffer("");
+	threadBufferSession = currentSession;
+
+	return threadBuffer;
+}
+
+Trace::ThreadBuffer* Trace::CreateBuffer(const char* name)
+{
+	std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+	buffer->name = name;
+	buffer->events.reset(new TraceEvent[TRACE_EVENTS_PER_THREAD]);
+	buffer->count = 0;
+	buffer->dropped = 0;
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	buffer->threadID = static_cast<uint32_t>(buffers.size() + 1);
+	buffers.push_back(std::move(buffer));
+
+	return buffers.back().get();
+}
+
+bool Trace::Save()
+{
+	FILE* file = fopen(filePath.c_str(), "w");
+
+	if (file == nullptr)
+	{
+		LOG_PRINT(LogTypes::Error, "Can't write the trace to %s", filePath.c_str());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	double microsecondsPerTick = 1000000.0 / SDL_GetPerformanceFrequency();
+	uint64_t numEvents = 0, numDropped = 0;
+	bool isFirst = true;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+	{
+		if (!buffer->name.empty())
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", isFirst ? "" : ",\n", buffer->threadID, buffer->name.c_str());
+			isFirst = false;
+		}
+
+		for (size_t e = 0; e < buffer->count; e++)
+		{
+			const TraceEvent* event = &buffer->events[e];
+
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", isFirst ? "" : ",\n", event->name, buffer->threadID,
+				(event->startTime - startTime) * microsecondsPerTick, (event->endTime - event->startTime) * microsecondsPerTick);
+			isFirst = false;
+		}
+
+		numEvents += buffer->count;
+		numDropped += buffer->dropped;
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	LOG_PRINT(LogTypes::Info, "Trace with %llu zones of %u threads written to %s, %llu dropped.", static_cast<unsigned long long>(numEvents), static_cast<uint32_t>(buffers.size()),
+		filePath.c_str(), static_cast<unsigned long long>(numDropped));
+
+	return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+// Zones kept for each thread, later ones are dropped
+
+constexpr size_t TRACE_EVENTS_PER_THREAD = 128 * 1024;
+
+// Buffers that can be reserved for threads that must not allocate nor lock
+
+constexpr size_t TRACE_RESERVED_BUFFERS = 4;
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+struct TraceEvent
+{
+	const char* name; // Must be a literal, only the pointer is kept
+	Uint64 startTime;
+	Uint64 endTime;
+};
+
+// Timed zones written as Chrome trace events, so a playthrough can be opened
+// in Perfetto or chrome://tracing. Every thread writes to its own buffer
+// without locks, and the buffers are only read when the trace is saved,
+// once the other threads have stopped. A thread allocates its buffer with
+// its first zone, under a lock, unless it claims one reserved for it.
+
+class Trace
+{
+private:
+	struct ThreadBuffer
+	{
+		std::string name;
+		uint32_t threadID;
+		std::unique_ptr<TraceEvent[]> events;
+		size_t count;
+		uint64_t dropped;
+	};
+
+	static std::atomic<bool> isEnabled;
+	static std::atomic<uint32_t> session;
+	static std::mutex buffersMutex;
+	static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	static std::atomic<ThreadBuffer*> reservedBuffers[TRACE_RESERVED_BUFFERS];
+	static std::string filePath;
+	static Uint64 startTime;
+
+	static thread_local ThreadBuffer* threadBuffer;
+	static thread_local uint32_t threadBufferSession;
+
+public:
+	static void Initialize(const std::string& filePath);
+	static void Dispose();
+
+	static void SetThreadName(const char* name);
+
+	// Returns the reservation to claim, 0 when tracing is disabled or there is none left
+	static uint32_t ReserveBuffer(const char* threadName);
+	// Lock-free, the first call on a thread makes the reserved buffer its own
+	static void ClaimBuffer(const uint32_t reservation);
+	static void AddZone(const char* name, const Uint64 startTime, const Uint64 endTime);
+
+	inline static bool IsEnabled() { return isEnabled.load(std::memory_order_relaxed); }
+
+private:
+	static ThreadBuffer* GetThreadBuffer();
+	static ThreadBuffer* CreateBuffer(const char* name);
+	static bool Save();
+};
+
+class TraceZone
+{
+private:
+	const char* name;
+	Uint64 startTime;
+
+public:
+	inline TraceZone(const char* name) : name(name), startTime(Trace::IsEnabled() ? SDL_GetPerformanceCounter() : 0) { }
+	inline ~TraceZone() { if (startTime != 0) Trace::AddZone(name, startTime, SDL_GetPerformanceCounter()); }
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from exactly one writer thread to exactly one reader
+// thread without locks. Each side owns one of the three slots, and the third
+// one is swapped with an atomic exchange when a value is published or taken,
+// so neither side ever waits for the other. Values the reader doesn't take in
+// time are overwritten by newer ones.
+
+template <typename T>
+class TripleBuffer
+{
+private:
+	static constexpr uint8_t SLOT_INDEX_MASK = 0x3;
+	static constexpr uint8_t SLOT_FRESH_FLAG = 0x4; // Set when the middle slot hasn't been taken
+
+	T slots[3];
+	std::atomic<uint8_t> middleSlot;
+	uint8_t backSlot; // Only used by the writer
+	uint8_t frontSlot; // Only used by the reader
+
+public:
+	TripleBuffer() : middleSlot(1), backSlot(2), frontSlot(0) {}
+
+	// Writer side, fill the back slot and then publish it
+
+	inline T* GetBack() { return &slots[backSlot]; }
+
+	inline void Publish()
+	{
+		uint8_t previous = middleSlot.exchange(backSlot | SLOT_FRESH_FLAG, std::memory_order_acq_rel);
+		backSlot = previous & SLOT_INDEX_MASK;
+	}
+
+	// Reader side, returns false and keeps the current front slot if nothing new was published
+
+	inline bool Acquire()
+	{
+		if (!(middleSlot.load(std::memory_order_relaxed) & SLOT_FRESH_FLAG)) return false;
+
+		uint8_t previous = middleSlot.exchange(frontSlot, std::memory_order_acq_rel);
+		frontSlot = previous & SLOT_INDEX_MASK;
+
+		return true;
+	}
+
+	inline const T& GetFront() const { return slots[frontSlot]; }
+};
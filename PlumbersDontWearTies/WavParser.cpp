@@ -0,0 +1,82 @@
+#include "WavParser.h"
+
+#include <cstring>
+
+constexpr size_t RIFF_HEADER_SIZE = 12;
+constexpr size_t RIFF_CHUNK_HEADER_SIZE = 8;
+constexpr size_t WAV_FMT_CHUNK_MIN_SIZE = 16;
+
+static inline uint16_t ReadUInt16(const uint8_t* data)
+{
+	return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t ReadUInt32(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24));
+}
+
+bool WavParser::Parse(const uint8_t* data, const size_t size, WavInfo* info)
+{
+	if (size < RIFF_HEADER_SIZE) return false;
+	if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) return false;
+
+	bool hasFormat = false;
+	bool hasData = false;
+	size_t offset = RIFF_HEADER_SIZE;
+
+	while (offset + RIFF_CHUNK_HEADER_SIZE <= size && !(hasFormat && hasData))
+	{
+		const uint8_t* chunk = data + offset;
+		size_t chunkSize = ReadUInt32(chunk + 4);
+		size_t chunkDataOffset = offset + RIFF_CHUNK_HEADER_SIZE;
+
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			if (chunkSize < WAV_FMT_CHUNK_MIN_SIZE || chunkDataOffset + WAV_FMT_CHUNK_MIN_SIZE > size) return false;
+
+			const uint8_t* format = data + chunkDataOffset;
+			info->formatTag = ReadUInt16(format);
+			info->channels = ReadUInt16(format + 2);
+			info->sampleRate = ReadUInt32(format + 4);
+			info->blockAlign = ReadUInt16(format + 12);
+			info->bitsPerSample = ReadUInt16(format + 14);
+			hasFormat = true;
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			// Some files declare more data than they actually contain
+
+			info->dataOffset = chunkDataOffset;
+			info->dataSize = chunkSize < size - chunkDataOffset ? chunkSize : size - chunkDataOffset;
+			hasData = true;
+		}
+
+		// Chunks are padded to an even size. One that runs past the end is the
+		// last, checked before adding so a 32 bit size_t can't wrap around.
+
+		if (chunkSize > size - chunkDataOffset) break;
+
+		offset = chunkDataOffset + chunkSize + (chunkSize & 1);
+	}
+
+	if (!hasFormat || !hasData) return false;
+	if (info->formatTag != WAV_FORMAT_TAG_PCM || info->channels == 0 || info->sampleRate == 0 || info->blockAlign == 0) return false;
+	if (GetAudioFormat(*info) == 0) return false;
+
+	// Drop a trailing partial sample frame
+
+	info->dataSize -= info->dataSize % info->blockAlign;
+
+	return true;
+}
+
+SDL_AudioFormat WavParser::GetAudioFormat(const WavInfo& info)
+{
+	switch (info.bitsPerSample)
+	{
+		case 8: return AUDIO_U8;
+		case 16: return AUDIO_S16LSB;
+		default: return 0;
+	}
+}
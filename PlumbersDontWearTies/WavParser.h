@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <SDL.h>
+
+constexpr uint16_t WAV_FORMAT_TAG_PCM = 1;
+
+struct WavInfo
+{
+	uint16_t formatTag;
+	uint16_t channels;
+	uint32_t sampleRate;
+	uint16_t bitsPerSample;
+	uint16_t blockAlign;
+	size_t dataOffset;
+	size_t dataSize;
+};
+
+// Walks the chunks of a RIFF WAVE file to find the "fmt " and "data" chunks
+
+class WavParser
+{
+public:
+	static bool Parse(const uint8_t* data, const size_t size, WavInfo* info);
+	static SDL_AudioFormat GetAudioFormat(const WavInfo& info);
+};
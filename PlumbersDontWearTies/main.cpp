@@ -1,26 +1,42 @@
 #include "main.h"
 
+#include "AssetArchive.h"
 #include "Audio.h"
+#include "FrameStats.h"
 #include "Game.h"
+#include "GameThread.h"
 #include "Log.h"
+#include "PictureCache.h"
+#include "PicturePrefetcher.h"
 #include "Renderer.h"
+#include "Trace.h"
 
 #include "Config.h"
 
+#include <cmath>
 #include <iostream>
 
 constexpr const char* BASE_DATA_PATH = "Data/";
 
 int main(int argc, char** args)
 {
+	Log::Initialize();
+	ParseArguments(argc, args);
+	Trace::SetThreadName("Main");
+
 	// Initialize SDL
 
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER) < 0)
 	{
-		Log::Print(LogTypes::Critical, "Error initializing SDL: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Critical, "Error initializing SDL: %s", SDL_GetError());
+		Log::Dispose();
 		return EXIT_FAILURE;
 	}
 
+	// Open the archive, if there is none the loose files are used
+
+	AssetArchive::Initialize(BASE_DATA_PATH);
+
 	// Create window
 
 	std::string title = "Plumbers Don't Wear Ties - v";
@@ -28,8 +44,10 @@ int main(int argc, char** args)
 
 	if (window == nullptr)
 	{
-		Log::Print(LogTypes::Critical, "Could not create a window: %s", SDL_GetError());
+		LOG_PRINT(LogTypes::Critical, "Could not create a window: %s", SDL_GetError());
+		AssetArchive::Dispose();
 		SDL_Quit();
+		Log::Dispose();
 		return EXIT_FAILURE;
 	}
 
@@ -37,7 +55,9 @@ int main(int argc, char** args)
 
 	if (!Renderer::Initialize(window, std::string(BASE_DATA_PATH) + "Font.ttf"))
 	{
+		AssetArchive::Dispose();
 		SDL_Quit();
+		Log::Dispose();
 		return EXIT_FAILURE;
 	}
 
@@ -46,10 +66,18 @@ int main(int argc, char** args)
 	if (!Audio::Initialize())
 	{
 		Renderer::Dispose();
+		AssetArchive::Dispose();
 		SDL_Quit();
+		Log::Dispose();
 		return EXIT_FAILURE;
 	}
 
+	// Initialize picture cache and prefetcher, which fills the cache too
+
+	PictureCache::Initialize();
+
+	PicturePrefetcher::Initialize(Renderer::GetNativeTextureFormat());
+
 	// Initialize game controller
 
 	controller = nullptr;
@@ -61,19 +89,43 @@ int main(int argc, char** args)
 	Game* game = new Game(BASE_DATA_PATH);
 	game->Start();
 
-	Uint64 previousTime = SDL_GetPerformanceCounter();
+	// From here on the game is only used by the game thread
+
+	if (!GameThread::Initialize(game))
+	{
+		delete game;
+		PicturePrefetcher::Dispose();
+		PictureCache::Dispose();
+		Audio::Dispose();
+		Renderer::Dispose();
+		AssetArchive::Dispose();
+		SDL_Quit();
+		Log::Dispose();
+		return EXIT_FAILURE;
+	}
+
 	int16_t previousControllerYAxis = 0;
+	bool isRunning = true;
 
-	while (game->IsRunning())
+	while (isRunning)
 	{
+		// Sleep until there is input, a new frame from the game thread or something to redraw
+
 		SDL_Event event;
-		while (SDL_PollEvent(&event))
+		int hasEvent = SDL_WaitEventTimeout(&event, GetEventTimeout(GameThread::GetFrame()));
+
+		TRACE_ZONE("Frame");
+		FrameStats::BeginFrame();
+
+		bool isRedrawNeeded = false;
+
+		for (; hasEvent; hasEvent = SDL_PollEvent(&event))
 		{
 			switch (event.type)
 			{
 				case SDL_QUIT:
 				{
-					game->Stop();
+					GameThread::PostInput(GameInputs::Stop);
 					break;
 				}
 				case SDL_KEYDOWN:
@@ -81,34 +133,38 @@ int main(int argc, char** args)
 					switch (event.key.keysym.sym)
 					{
 						case SDLK_ESCAPE:
-							game->Stop();
+							GameThread::PostInput(GameInputs::Stop);
 							break;
 						case SDLK_1:
 						case SDLK_KP_1:
-							game->SelectDecision(0);
+							GameThread::PostInput(GameInputs::SelectDecision, 0);
 							break;
 						case SDLK_2:
 						case SDLK_KP_2:
-							game->SelectDecision(1);
+							GameThread::PostInput(GameInputs::SelectDecision, 1);
 							break;
 						case SDLK_3:
 						case SDLK_KP_3:
-							game->SelectDecision(2);
+							GameThread::PostInput(GameInputs::SelectDecision, 2);
 							break;
 						case SDLK_DOWN:
-							game->SelectNextDecision();
+							GameThread::PostInput(GameInputs::SelectNextDecision);
 							break;
 						case SDLK_UP:
-							game->SelectPreviousDecision();
+							GameThread::PostInput(GameInputs::SelectPreviousDecision);
 							break;
 						case SDLK_SPACE:
-							game->AdvancePicture();
+							GameThread::PostInput(GameInputs::AdvancePicture);
 							break;
 						case SDLK_RETURN:
 							if (event.key.keysym.mod & KMOD_ALT)
 								ToggleFullscreen(window);
 							else
-								game->AdvancePicture();
+								GameThread::PostInput(GameInputs::AdvancePicture);
+							break;
+						case SDLK_F3:
+							FrameStats::ToggleOverlay();
+							isRedrawNeeded = true;
 							break;
 					}
 
@@ -119,16 +175,16 @@ int main(int argc, char** args)
 					switch (event.cbutton.button)
 					{
 						case SDL_CONTROLLER_BUTTON_BACK:
-							game->Stop();
+							GameThread::PostInput(GameInputs::Stop);
 							break;
 						case SDL_CONTROLLER_BUTTON_DPAD_DOWN:
-							game->SelectNextDecision();
+							GameThread::PostInput(GameInputs::SelectNextDecision);
 							break;
 						case SDL_CONTROLLER_BUTTON_DPAD_UP:
-							game->SelectPreviousDecision();
+							GameThread::PostInput(GameInputs::SelectPreviousDecision);
 							break;
 						case SDL_CONTROLLER_BUTTON_A:
-							game->AdvancePicture();
+							GameThread::PostInput(GameInputs::AdvancePicture);
 							break;
 						case SDL_CONTROLLER_BUTTON_START:
 							ToggleFullscreen(window);
@@ -143,9 +199,9 @@ int main(int argc, char** args)
 					{
 						case SDL_CONTROLLER_AXIS_LEFTY:
 							if (previousControllerYAxis <= 24000 && event.caxis.value > 24000)
-								game->SelectNextDecision();
+								GameThread::PostInput(GameInputs::SelectNextDecision);
 							else if (previousControllerYAxis >= -24000 && event.caxis.value < -24000)
-								game->SelectPreviousDecision();
+								GameThread::PostInput(GameInputs::SelectPreviousDecision);
 
 							previousControllerYAxis = event.caxis.value;
 
@@ -165,7 +221,7 @@ int main(int argc, char** args)
 						controller = nullptr;
 						controllerInstanceID = -1;
 
-						Log::Print(LogTypes::Info, "Controller has been disconnected: instance ID %i", event.cdevice.which);
+						LOG_PRINT(LogTypes::Info, "Controller has been disconnected: instance ID %i", event.cdevice.which);
 
 						OpenFirstAvailableController();
 					}
@@ -174,6 +230,8 @@ int main(int argc, char** args)
 				}
 				case SDL_WINDOWEVENT:
 				{
+					isRedrawNeeded = true;
+
 					switch (event.window.event)
 					{
 						case SDL_WINDOWEVENT_SIZE_CHANGED:
@@ -186,14 +244,39 @@ int main(int argc, char** args)
 			}
 		}
 
-		Uint64 currentTime = SDL_GetPerformanceCounter();
-		double deltaSeconds = (currentTime - previousTime) / (double)SDL_GetPerformanceFrequency();
-		previousTime = currentTime;
+		FrameStats::EndPhase(FramePhases::Events);
+
+		// Take the latest frame of the game thread, the ones in between are skipped
+
+		if (GameThread::AcquireFrame())
+		{
+			Renderer::SetFrame(BASE_DATA_PATH, GameThread::GetFrame());
+			isRedrawNeeded = true;
+		}
 
-		game->Update(deltaSeconds);
-		game->Render();
+		const FrameSnapshot& frame = GameThread::GetFrame();
+		isRunning = frame.isRunning;
+		FrameStats::EndPhase(FramePhases::Upload);
+
+		// A still picture is only drawn again when the window needs it,
+		// but the highlight of the selected decision pulses
+
+		if (isRedrawNeeded || frame.hasSelection || FrameStats::IsOverlayVisible())
+		{
+			Renderer::RenderFrame(frame);
+			if (FrameStats::IsOverlayVisible()) Renderer::RenderOverlay();
+			FrameStats::EndPhase(FramePhases::Render);
+
+			Renderer::Present();
+			FrameStats::EndPhase(FramePhases::Present);
+		}
+
+		FrameStats::EndFrame();
 	}
 
+	FrameStats::Dispose();
+
+	GameThread::Dispose();
 	delete game;
 	game = nullptr;
 
@@ -203,14 +286,73 @@ int main(int argc, char** args)
 		controller = nullptr;
 	}
 
+	PicturePrefetcher::Dispose();
+	PictureCache::Dispose();
 	Audio::Dispose();
 	Renderer::Dispose();
+	AssetArchive::Dispose();
 	SDL_DestroyWindow(window);
+	Trace::Dispose();
 	SDL_Quit();
+	Log::Dispose();
 
 	return EXIT_SUCCESS;
 }
 
+void ParseArguments(int argc, char** args)
+{
+	for (int a = 1; a < argc; a++)
+	{
+		std::string argument = args[a];
+
+		if (argument == "--texture-cache-mb" && a + 1 < argc)
+		{
+			int32_t megabytes = atoi(args[++a]);
+			if (megabytes >= 0) Renderer::SetTextureCacheBudget(static_cast<size_t>(megabytes) * 1024 * 1024);
+		}
+		else if (argument == "--streaming-textures")
+		{
+			Renderer::SetStreamingTextures(true);
+		}
+		else if (argument == "--picture-cache-mb" && a + 1 < argc)
+		{
+			int32_t megabytes = atoi(args[++a]);
+			if (megabytes >= 0) PictureCache::SetBudget(static_cast<uint64_t>(megabytes) * 1024 * 1024);
+		}
+		else if (argument == "--render-driver" && a + 1 < argc)
+		{
+			Renderer::SetRenderDriver(args[++a]);
+		}
+		else if (argument == "--software-scaling" && a + 1 < argc)
+		{
+			std::string mode = args[++a];
+
+			if (mode == "auto")
+				Renderer::SetSoftwareScaling(SoftwareScalingModes::Auto);
+			else if (mode == "off")
+				Renderer::SetSoftwareScaling(SoftwareScalingModes::Off);
+			else if (mode == "nearest")
+				Renderer::SetSoftwareScaling(SoftwareScalingModes::Nearest);
+			else if (mode == "bilinear")
+				Renderer::SetSoftwareScaling(SoftwareScalingModes::Bilinear);
+			else
+				LOG_PRINT(LogTypes::Warning, "Unknown software scaling mode: %s", mode.c_str());
+		}
+		else if (argument == "--frame-stats" && a + 1 < argc)
+		{
+			FrameStats::SetStatsFile(args[++a]);
+		}
+		else if (argument == "--trace" && a + 1 < argc)
+		{
+			Trace::Initialize(args[++a]);
+		}
+		else
+		{
+			LOG_PRINT(LogTypes::Warning, "Unknown argument: %s", argument.c_str());
+		}
+	}
+}
+
 void ToggleFullscreen(SDL_Window* window)
 {
 	bool isFullscreen = SDL_GetWindowFlags(window) & SDL_WINDOW_FULLSCREEN_DESKTOP;
@@ -218,15 +360,29 @@ void ToggleFullscreen(SDL_Window* window)
 	if (isFullscreen)
 	{
 		if (SDL_SetWindowFullscreen(window, 0) < 0)
-			Log::Print(LogTypes::Error, "Can't set the game to window mode: %s", SDL_GetError());
+			LOG_PRINT(LogTypes::Error, "Can't set the game to window mode: %s", SDL_GetError());
 	}
 	else
 	{
 		if (SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP) < 0)
-			Log::Print(LogTypes::Error, "Can't set the game to full screen mode: %s", SDL_GetError());
+			LOG_PRINT(LogTypes::Error, "Can't set the game to full screen mode: %s", SDL_GetError());
 	}
 }
 
+int32_t GetEventTimeout(const FrameSnapshot& frame)
+{
+	// Milliseconds until the next redraw that no event asks for, -1 to wait only for events
+
+	double deadline = frame.hasSelection ? DECISION_PULSE_INTERVAL : -1.0;
+
+	if (FrameStats::IsOverlayVisible() && (deadline < 0.0 || deadline > FRAME_OVERLAY_INTERVAL))
+		deadline = FRAME_OVERLAY_INTERVAL;
+
+	if (deadline < 0.0) return -1;
+
+	return static_cast<int32_t>(ceil(deadline * 1000.0));
+}
+
 void OpenFirstAvailableController()
 {
 	if (controller != nullptr) return;
@@ -241,7 +397,7 @@ void OpenFirstAvailableController()
 			SDL_Joystick* joystick = SDL_GameControllerGetJoystick(controller);
 			controllerInstanceID = SDL_JoystickInstanceID(joystick);
 
-			Log::Print(LogTypes::Info, "Found new controller: index %i, instance ID %i, name %s.", j, controllerInstanceID, SDL_GameControllerName(controller));
+			LOG_PRINT(LogTypes::Info, "Found new controller: index %i, instance ID %i, name %s.", j, controllerInstanceID, SDL_GameControllerName(controller));
 
 			return;
 		}
@@ -2,9 +2,13 @@
 
 #include <SDL.h>
 
+struct FrameSnapshot;
+
 SDL_GameController* controller;
 SDL_JoystickID controllerInstanceID;
 
 int main(int argc, char** args);
+void ParseArguments(int argc, char** args);
 void ToggleFullscreen(SDL_Window* window);
+int32_t GetEventTimeout(const FrameSnapshot& frame);
 void OpenFirstAvailableController();